@@ -0,0 +1,1684 @@
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+#ifndef BPLUS_TREE_MAP_H
+#include "bplus-tree-map.h"
+#endif
+
+#ifndef BPLUS_TREE_MAP_CPP
+#define BPLUS_TREE_MAP_CPP
+
+namespace CS280 {
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  template<typename KeyArg, typename... Args>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Node::Node(
+    std::in_place_t,
+    KeyArg&& key,
+    Args&&... args
+  ):
+      key(std::forward<KeyArg>(key)),
+      value(std::forward<Args>(args)...) {}
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Node::Key() const
+    -> const K& {
+    return key;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Node::Value() -> V& {
+    return value;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Node::Value() const
+    -> const V& {
+    return value;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::iterator(
+    Leaf* leaf,
+    usize index
+  ):
+      leaf{leaf},
+      index{index} {}
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator++()
+    -> iterator& {
+    if (++index == leaf->count and leaf->next) {
+      leaf = leaf->next;
+      index = 0;
+    }
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator++(int)
+    -> iterator {
+    iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator--()
+    -> iterator& {
+    if (index == 0) {
+      leaf = leaf->prev;
+      index = leaf->count;
+    }
+    index--;
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator--(int)
+    -> iterator {
+    iterator old = *this;
+    --*this;
+    return old;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator*() const
+    -> Node& {
+    return *leaf->slot(index);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator->() const
+    -> Node* {
+    return leaf->slot(index);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator!=(
+    const iterator& rhs
+  ) const -> bool {
+    return index != rhs.index or leaf != rhs.leaf;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::iterator::operator==(
+    const iterator& rhs
+  ) const -> bool {
+    return index == rhs.index and leaf == rhs.leaf;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::const_iterator(
+    const Leaf* leaf,
+    usize index
+  ):
+      leaf{leaf},
+      index{index} {}
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator++()
+    -> const_iterator& {
+    if (++index == leaf->count and leaf->next) {
+      leaf = leaf->next;
+      index = 0;
+    }
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator++(
+    int
+  ) -> const_iterator {
+    const_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator--()
+    -> const_iterator& {
+    if (index == 0) {
+      leaf = leaf->prev;
+      index = leaf->count;
+    }
+    index--;
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator--(
+    int
+  ) -> const_iterator {
+    const_iterator old = *this;
+    --*this;
+    return old;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator*() const
+    -> const Node& {
+    return *leaf->slot(index);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator->() const
+    -> const Node* {
+    return leaf->slot(index);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator!=(
+    const const_iterator& rhs
+  ) const -> bool {
+    return index != rhs.index or leaf != rhs.leaf;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::const_iterator::operator==(
+    const const_iterator& rhs
+  ) const -> bool {
+    return index == rhs.index and leaf == rhs.leaf;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Leaf::slot(usize i)
+    -> Node* {
+    return std::launder(reinterpret_cast<Node*>(bytes)) + i;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Leaf::slot(usize i) const
+    -> const Node* {
+    return std::launder(reinterpret_cast<const Node*>(bytes)) + i;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Inner::key(usize i)
+    -> K* {
+    return std::launder(reinterpret_cast<K*>(bytes)) + i;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::Inner::key(usize i) const
+    -> const K* {
+    return std::launder(reinterpret_cast<const K*>(bytes)) + i;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::BPlusTreeMap():
+      BPlusTreeMap(Compare()) {}
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::BPlusTreeMap(
+    const Compare& comp,
+    const Allocator& alloc
+  ):
+      comp{comp},
+      leaves{alloc},
+      inners{alloc},
+      root{nullptr},
+      head{nullptr},
+      tail{nullptr},
+      height{0},
+      count{0} {}
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::BPlusTreeMap(
+    const BPlusTreeMap& rhs
+  ):
+      comp{rhs.comp},
+      leaves{leaf_traits::select_on_container_copy_construction(rhs.leaves)},
+      inners{inner_traits::select_on_container_copy_construction(rhs.inners)},
+      root{nullptr},
+      head{nullptr},
+      tail{nullptr},
+      height{0},
+      count{0} {
+    if (rhs.count == 0) {
+      return;
+    }
+
+    // every inner node made so far, which only hang together once the root
+    // is there
+    std::vector<Inner*> made;
+
+    try {
+      // the pairs in order into full leaves
+      const usize leaf_count = (rhs.count + Fanout - 1) / Fanout;
+      std::vector<Base*> level;
+      level.reserve(leaf_count);
+
+      const_iterator pair = rhs.begin();
+      for (usize i = 0; i < leaf_count; ++i) {
+        Leaf* const leaf = make_leaf();
+        leaf->prev = tail;
+        (tail ? tail->next : head) = leaf;
+        tail = leaf;
+        level.push_back(leaf);
+
+        const usize n = packed(rhs.count, Fanout, min_leaf, i);
+        for (; leaf->count < n; ++pair) {
+          ::new (leaf->slot(leaf->count))
+            Node(std::in_place, pair->key, pair->value);
+          leaf->count++;
+          count++;
+        }
+      }
+      height = 1;
+
+      // then a level of inner nodes over the one below until one is left,
+      // the separator in front of a child is the first key under it
+      while (level.size() > 1) {
+        const usize nodes = (level.size() + Fanout - 1) / Fanout;
+        std::vector<Base*> above;
+        above.reserve(nodes);
+        made.reserve(made.size() + nodes);
+
+        usize child = 0;
+        for (usize i = 0; i < nodes; ++i) {
+          Inner* const node = make_inner();
+          made.push_back(node);
+          above.push_back(node);
+
+          const usize n = packed(level.size(), Fanout, min_inner + 1, i);
+          node->children[0] = level[child++];
+          while (node->count + 1 < n) {
+            Base* first = level[child];
+            for (usize below = height; below > 1; --below) {
+              first = static_cast<Inner*>(first)->children[0];
+            }
+
+            ::new (node->key(node->count))
+              K(static_cast<Leaf*>(first)->slot(0)->key);
+            node->children[node->count + 1] = level[child++];
+            node->count++;
+          }
+        }
+
+        level = std::move(above);
+        height++;
+      }
+
+      root = level[0];
+    } catch (...) {
+      // nothing hangs off the inner nodes yet, the leaves go by their links
+      for (Inner* const node: made) {
+        for (usize i = 0; i < node->count; ++i) {
+          node->key(i)->~K();
+        }
+        free_inner(node);
+      }
+      for (Leaf* leaf = head; leaf;) {
+        Leaf* const next = leaf->next;
+        for (usize i = 0; i < leaf->count; ++i) {
+          leaf->slot(i)->~Node();
+        }
+        free_leaf(leaf);
+        leaf = next;
+      }
+      throw;
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::BPlusTreeMap(
+    BPlusTreeMap&& from
+  ):
+      comp{std::move(from.comp)},
+      leaves{std::move(from.leaves)},
+      inners{std::move(from.inners)},
+      root{std::exchange(from.root, nullptr)},
+      head{std::exchange(from.head, nullptr)},
+      tail{std::exchange(from.tail, nullptr)},
+      height{std::exchange(from.height, 0)},
+      count{std::exchange(from.count, 0)} {}
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::operator=(
+    const BPlusTreeMap& rhs
+  ) -> BPlusTreeMap& {
+    if (this != &rhs) {
+      BPlusTreeMap copy{rhs};
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::operator=(
+    BPlusTreeMap&& rhs
+  ) -> BPlusTreeMap& {
+    if (this != &rhs) {
+      clear();
+      std::swap(comp, rhs.comp);
+      std::swap(leaves, rhs.leaves);
+      std::swap(inners, rhs.inners);
+      std::swap(root, rhs.root);
+      std::swap(head, rhs.head);
+      std::swap(tail, rhs.tail);
+      std::swap(height, rhs.height);
+      std::swap(count, rhs.count);
+    }
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  BPlusTreeMap<K, V, Fanout, Compare, Allocator>::~BPlusTreeMap() {
+    clear();
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::size() const -> usize {
+    return count;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::empty() const -> bool {
+    return count == 0;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::clear() -> void {
+    if (root) {
+      destroy(root, 0);
+    }
+
+    root = nullptr;
+    head = nullptr;
+    tail = nullptr;
+    height = 0;
+    count = 0;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::operator[](const K& key)
+    -> V& {
+    return try_emplace(key).first->value;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  template<typename... Args>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::try_emplace(
+    const K& key,
+    Args&&... args
+  ) -> std::pair<iterator, bool> {
+    Path path;
+    Leaf* leaf = root ? descend(key, path) : nullptr;
+    usize index = leaf ? lower_in(leaf, key) : 0;
+
+    if (leaf and index < leaf->count and
+        not comp(key, leaf->slot(index)->key)) {
+      return {iterator{leaf, index}, false};
+    }
+
+    if (leaf == nullptr) {
+      leaf = make_leaf();
+      try {
+        ::new (leaf->slot(0))
+          Node(std::in_place, key, std::forward<Args>(args)...);
+      } catch (...) {
+        free_leaf(leaf);
+        throw;
+      }
+      leaf->count = 1;
+      count = 1;
+
+      root = leaf;
+      head = leaf;
+      tail = leaf;
+      height = 1;
+      return {iterator{leaf, 0}, true};
+    }
+
+    if (leaf->count < Fanout) {
+      emplace_at(leaf, index, key, std::forward<Args>(args)...);
+      return {iterator{leaf, index}, true};
+    }
+
+    // a full leaf gets a new one after it. A key past the end of the last
+    // leaf starts it on its own, so sorted inserts leave full leaves, any
+    // other key sends the upper half over. Whatever can throw goes first,
+    // while the new leaf can still be dropped
+    Leaf* const right = make_leaf();
+    const usize keep = Fanout / 2;
+    const bool append = leaf == tail and index == Fanout;
+
+    try {
+      if (append) {
+        ::new (right->slot(0))
+          Node(std::in_place, key, std::forward<Args>(args)...);
+        right->count = 1;
+        insert_child(path, height - 1, key, right);
+      } else {
+        insert_child(path, height - 1, leaf->slot(keep)->key, right);
+      }
+    } catch (...) {
+      if (right->count > 0) {
+        right->slot(0)->~Node();
+      }
+      free_leaf(right);
+      throw;
+    }
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    (right->next ? right->next->prev : tail) = right;
+    leaf->next = right;
+
+    if (append) {
+      count++;
+      return {iterator{right, 0}, true};
+    }
+
+    move_pairs(leaf, keep, Fanout - keep, right);
+    leaf->count = keep;
+
+    if (index > keep) {
+      leaf = right;
+      index -= keep;
+    }
+
+    // both halves are in the tree by now, so a throw here leaves the pairs
+    // that were there
+    emplace_at(leaf, index, key, std::forward<Args>(args)...);
+    return {iterator{leaf, index}, true};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::begin() -> iterator {
+    return iterator{head, 0};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::end() -> iterator {
+    return past_end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::rbegin()
+    -> reverse_iterator {
+    return reverse_iterator{end()};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::rend()
+    -> reverse_iterator {
+    return reverse_iterator{begin()};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::find(const K& key)
+    -> iterator {
+    return match(key);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::lower_bound(const K& key)
+    -> iterator {
+    return bound(key, false);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::upper_bound(const K& key)
+    -> iterator {
+    return bound(key, true);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::erase(iterator it)
+    -> void {
+    Path path;
+    descend(it->key, path);
+    erase_slot(path, it.leaf, it.index);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::erase(const K& key)
+    -> usize {
+    if (root == nullptr) {
+      return 0;
+    }
+
+    Path path;
+    Leaf* const leaf = descend(key, path);
+    const usize index = lower_in(leaf, key);
+
+    if (index == leaf->count or comp(key, leaf->slot(index)->key)) {
+      return 0;
+    }
+
+    erase_slot(path, leaf, index);
+    return 1;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::begin() const
+    -> const_iterator {
+    return const_iterator{head, 0};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::end() const
+    -> const_iterator {
+    const iterator it = past_end();
+    return const_iterator{it.leaf, it.index};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::rbegin() const
+    -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::rend() const
+    -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::find(const K& key) const
+    -> const_iterator {
+    const iterator it = match(key);
+    return const_iterator{it.leaf, it.index};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::lower_bound(
+    const K& key
+  ) const -> const_iterator {
+    const iterator it = bound(key, false);
+    return const_iterator{it.leaf, it.index};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::upper_bound(
+    const K& key
+  ) const -> const_iterator {
+    const iterator it = bound(key, true);
+    return const_iterator{it.leaf, it.index};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::contains(
+    const K& key
+  ) const -> bool {
+    return match(key) != past_end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::depth() const -> usize {
+    return height;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::sanityCheck() const
+    -> bool {
+    if (root == nullptr) {
+      return head == nullptr and tail == nullptr and height == 0 and
+             count == 0;
+    }
+
+    const Leaf* next = head;
+    if (not check(root, 0, nullptr, nullptr, next) or next != nullptr) {
+      return false;
+    }
+
+    // the links both ways, and the pairs they pass
+    usize pairs = 0;
+    const Leaf* prev = nullptr;
+    for (const Leaf* leaf = head; leaf; leaf = leaf->next) {
+      if (leaf->prev != prev) {
+        return false;
+      }
+      pairs += leaf->count;
+      prev = leaf;
+    }
+
+    return prev == tail and pairs == count;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  template<typename Past>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::count_past(
+    usize n,
+    Past past
+  ) -> usize {
+    if constexpr (linear) {
+      // no early exit and no branch, the loop becomes vector compares
+      usize passed = 0;
+      for (usize i = 0; i < n; ++i) {
+        passed += past(i) ? 1 : 0;
+      }
+      return passed;
+    } else {
+      usize low = 0;
+      usize length = n;
+      while (length > 0) {
+        const usize half = length / 2;
+        if (past(low + half)) {
+          low += half + 1;
+          length -= half + 1;
+        } else {
+          length = half;
+        }
+      }
+      return low;
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::route(
+    const Inner* node,
+    const K& key
+  ) const -> usize {
+    return count_past(node->count, [this, node, &key](usize i) {
+      return not comp(key, *node->key(i));
+    });
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::lower_in(
+    const Leaf* leaf,
+    const K& key
+  ) const -> usize {
+    return count_past(leaf->count, [this, leaf, &key](usize i) {
+      return comp(leaf->slot(i)->key, key);
+    });
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::upper_in(
+    const Leaf* leaf,
+    const K& key
+  ) const -> usize {
+    return count_past(leaf->count, [this, leaf, &key](usize i) {
+      return not comp(key, leaf->slot(i)->key);
+    });
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::descend(
+    const K& key,
+    Path& path
+  ) const -> Leaf* {
+    Base* node = root;
+
+    for (usize level = 0; level + 1 < height; ++level) {
+      Inner* const inner = static_cast<Inner*>(node);
+      const usize child = route(inner, key);
+      path[level] = Step{inner, child};
+      node = inner->children[child];
+    }
+
+    return static_cast<Leaf*>(node);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::find_leaf(
+    const K& key
+  ) const -> Leaf* {
+    Base* node = root;
+
+    for (usize level = 0; level + 1 < height; ++level) {
+      const Inner* const inner = static_cast<const Inner*>(node);
+      node = inner->children[route(inner, key)];
+    }
+
+    return static_cast<Leaf*>(node);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::bound(
+    const K& key,
+    bool upper
+  ) const -> iterator {
+    if (root == nullptr) {
+      return past_end();
+    }
+
+    Leaf* const leaf = find_leaf(key);
+    const usize index = upper ? upper_in(leaf, key) : lower_in(leaf, key);
+
+    // past every key of this leaf, the next one starts at or above the
+    // separator that kept the key out of it
+    if (index == leaf->count and leaf->next) {
+      return iterator{leaf->next, 0};
+    }
+
+    return iterator{leaf, index};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::match(const K& key) const
+    -> iterator {
+    if (root == nullptr) {
+      return past_end();
+    }
+
+    Leaf* const leaf = find_leaf(key);
+    const usize index = lower_in(leaf, key);
+
+    if (index < leaf->count and not comp(key, leaf->slot(index)->key)) {
+      return iterator{leaf, index};
+    }
+
+    return past_end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::past_end() const
+    -> iterator {
+    return iterator{tail, tail ? tail->count : 0};
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::make_leaf() -> Leaf* {
+    Leaf* const leaf = leaf_traits::allocate(leaves, 1);
+    // default initialized, the slots are left as raw bytes
+    ::new (static_cast<void*>(leaf)) Leaf;
+    return leaf;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::make_inner() -> Inner* {
+    Inner* const node = inner_traits::allocate(inners, 1);
+    ::new (static_cast<void*>(node)) Inner;
+    return node;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::free_leaf(Leaf* leaf)
+    -> void {
+    leaf->~Leaf();
+    leaf_traits::deallocate(leaves, leaf, 1);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::free_inner(Inner* node)
+    -> void {
+    node->~Inner();
+    inner_traits::deallocate(inners, node, 1);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::destroy(
+    Base* node,
+    usize level
+  ) -> void {
+    if (level + 1 == height) {
+      Leaf* const leaf = static_cast<Leaf*>(node);
+      for (usize i = 0; i < leaf->count; ++i) {
+        leaf->slot(i)->~Node();
+      }
+      free_leaf(leaf);
+      return;
+    }
+
+    Inner* const inner = static_cast<Inner*>(node);
+    for (usize i = 0; i <= inner->count; ++i) {
+      destroy(inner->children[i], level + 1);
+    }
+    for (usize i = 0; i < inner->count; ++i) {
+      inner->key(i)->~K();
+    }
+    free_inner(inner);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::open(
+    Leaf* leaf,
+    usize at
+  ) -> void {
+    for (usize i = leaf->count; i > at; --i) {
+      ::new (leaf->slot(i)) Node(std::move(*leaf->slot(i - 1)));
+      leaf->slot(i - 1)->~Node();
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::close(
+    Leaf* leaf,
+    usize at
+  ) -> void {
+    for (usize i = at + 1; i < leaf->count; ++i) {
+      ::new (leaf->slot(i - 1)) Node(std::move(*leaf->slot(i)));
+      leaf->slot(i)->~Node();
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::move_pairs(
+    Leaf* source,
+    usize from,
+    usize n,
+    Leaf* target
+  ) -> void {
+    for (usize i = 0; i < n; ++i) {
+      Node* const pair = source->slot(from + i);
+      ::new (target->slot(target->count)) Node(std::move(*pair));
+      pair->~Node();
+      target->count++;
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  template<typename... Args>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::emplace_at(
+    Leaf* leaf,
+    usize index,
+    const K& key,
+    Args&&... args
+  ) -> void {
+    open(leaf, index);
+    leaf->count++;
+
+    try {
+      ::new (leaf->slot(index))
+        Node(std::in_place, key, std::forward<Args>(args)...);
+    } catch (...) {
+      close(leaf, index);
+      leaf->count--;
+      throw;
+    }
+
+    count++;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::insert_child(
+    Path& path,
+    usize above,
+    K separator,
+    Base* right
+  ) -> void {
+    // a sibling for every full node on the way up, and a new root if they
+    // all are
+    usize needed = 0;
+    while (needed < above and
+           path[above - 1 - needed].node->count == Fanout - 1) {
+      needed++;
+    }
+    if (needed == above) {
+      needed++;
+    }
+
+    std::array<Inner*, 64> spares;
+    usize spare = 0;
+    try {
+      for (; spare < needed; ++spare) {
+        spares[spare] = make_inner();
+      }
+    } catch (...) {
+      while (spare > 0) {
+        free_inner(spares[--spare]);
+      }
+      throw;
+    }
+
+    while (above > 0) {
+      const Step step = path[--above];
+      Inner* const node = step.node;
+      const usize at = step.child;
+
+      if (node->count < Fanout - 1) {
+        place_child(node, at, std::move(separator), right);
+        return;
+      }
+
+      // the node would have Fanout separators, 'separator' at 'at' among
+      // them, and Fanout + 1 children, 'right' after it. The upper half goes
+      // to the sibling and the one in the middle up, straight from where
+      // they are, then what is left closes up around the new one if it
+      // stays here
+      const auto key_at = [&](usize j) -> K* {
+        return j < at ? node->key(j) : j == at ? &separator : node->key(j - 1);
+      };
+      const auto child_at = [&](usize j) -> Base* {
+        return j <= at     ? node->children[j]
+               : j == at + 1 ? right
+                             : node->children[j - 1];
+      };
+      const auto moved_out = [&](K* key) {
+        if (key != &separator) {
+          key->~K();
+        }
+      };
+
+      const usize keep = Fanout / 2;
+      Inner* const sibling = spares[--spare];
+
+      for (usize j = keep + 1; j < Fanout; ++j) {
+        K* const key = key_at(j);
+        ::new (sibling->key(sibling->count)) K(std::move(*key));
+        moved_out(key);
+        sibling->children[sibling->count] = child_at(j);
+        sibling->count++;
+      }
+      sibling->children[sibling->count] = child_at(Fanout);
+
+      K* const up = key_at(keep);
+      K middle(std::move(*up));
+      moved_out(up);
+
+      if (at < keep) {
+        node->count = keep - 1;
+        place_child(node, at, std::move(separator), right);
+      } else {
+        node->count = keep;
+      }
+
+      separator = std::move(middle);
+      right = sibling;
+    }
+
+    Inner* const top = spares[--spare];
+    ::new (top->key(0)) K(std::move(separator));
+    top->children[0] = root;
+    top->children[1] = right;
+    top->count = 1;
+
+    root = top;
+    height++;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::packed(
+    usize total,
+    usize most,
+    usize least,
+    usize i
+  ) -> usize {
+    const usize nodes = (total + most - 1) / most;
+    const usize rest = total - (nodes - 1) * most;
+
+    if (nodes > 1 and rest < least and i + 2 >= nodes) {
+      const usize shared = most + rest;
+      return i + 2 == nodes ? shared - shared / 2 : shared / 2;
+    }
+
+    return i + 1 < nodes ? most : rest;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::place_child(
+    Inner* node,
+    usize at,
+    K&& separator,
+    Base* right
+  ) -> void {
+    for (usize i = node->count; i > at; --i) {
+      ::new (node->key(i)) K(std::move(*node->key(i - 1)));
+      node->key(i - 1)->~K();
+      node->children[i + 1] = node->children[i];
+    }
+
+    ::new (node->key(at)) K(std::move(separator));
+    node->children[at + 1] = right;
+    node->count++;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::remove_child(
+    Inner* node,
+    usize at
+  ) -> void {
+    node->key(at)->~K();
+
+    for (usize i = at; i + 1 < node->count; ++i) {
+      ::new (node->key(i)) K(std::move(*node->key(i + 1)));
+      node->key(i + 1)->~K();
+      node->children[i + 1] = node->children[i + 2];
+    }
+
+    node->count--;
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::erase_slot(
+    Path& path,
+    Leaf* leaf,
+    usize index
+  ) -> void {
+    leaf->slot(index)->~Node();
+    close(leaf, index);
+    leaf->count--;
+    count--;
+
+    if (height == 1) {
+      if (leaf->count == 0) {
+        free_leaf(leaf);
+        root = nullptr;
+        head = nullptr;
+        tail = nullptr;
+        height = 0;
+      }
+      return;
+    }
+
+    if (leaf->count < min_leaf) {
+      fix_leaf(path, leaf);
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::fix_leaf(
+    Path& path,
+    Leaf* leaf
+  ) -> void {
+    const Step step = path[height - 2];
+    Inner* const parent = step.node;
+    const usize at = step.child;
+
+    // siblings under the same parent, one of them is always there
+    Leaf* const left =
+      at > 0 ? static_cast<Leaf*>(parent->children[at - 1]) : nullptr;
+    Leaf* const right =
+      at < parent->count ? static_cast<Leaf*>(parent->children[at + 1])
+                         : nullptr;
+
+    if (left and left->count > min_leaf) {
+      Node* const last = left->slot(left->count - 1);
+      open(leaf, 0);
+      ::new (leaf->slot(0)) Node(std::move(*last));
+      last->~Node();
+      left->count--;
+      leaf->count++;
+
+      *parent->key(at - 1) = leaf->slot(0)->key;
+      return;
+    }
+
+    if (right and right->count > min_leaf) {
+      move_pairs(right, 0, 1, leaf);
+      close(right, 0);
+      right->count--;
+
+      *parent->key(at) = right->slot(0)->key;
+      return;
+    }
+
+    // neither can spare a pair, so the two fit in one: the right one of them
+    // empties into the left one and goes
+    Leaf* const into = left ? left : leaf;
+    Leaf* const from = left ? leaf : right;
+
+    move_pairs(from, 0, from->count, into);
+    from->count = 0;
+
+    into->next = from->next;
+    (into->next ? into->next->prev : tail) = into;
+
+    remove_child(parent, left ? at - 1 : at);
+    free_leaf(from);
+
+    fix_inner(path, height - 2);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::fix_inner(
+    Path& path,
+    usize level
+  ) -> void {
+    Inner* const node = path[level].node;
+
+    if (level == 0) {
+      // a root down to one child makes way for it
+      if (node->count == 0) {
+        root = node->children[0];
+        free_inner(node);
+        height--;
+      }
+      return;
+    }
+
+    if (node->count >= min_inner) {
+      return;
+    }
+
+    const Step step = path[level - 1];
+    Inner* const parent = step.node;
+    const usize at = step.child;
+
+    Inner* const left =
+      at > 0 ? static_cast<Inner*>(parent->children[at - 1]) : nullptr;
+    Inner* const right =
+      at < parent->count ? static_cast<Inner*>(parent->children[at + 1])
+                         : nullptr;
+
+    if (left and left->count > min_inner) {
+      // the separator of the parent comes down in front, the last separator
+      // of the left sibling goes up in its place with its last child moving
+      // over
+      for (usize i = node->count; i > 0; --i) {
+        ::new (node->key(i)) K(std::move(*node->key(i - 1)));
+        node->key(i - 1)->~K();
+      }
+      for (usize i = node->count + 1; i > 0; --i) {
+        node->children[i] = node->children[i - 1];
+      }
+
+      ::new (node->key(0)) K(std::move(*parent->key(at - 1)));
+      node->children[0] = left->children[left->count];
+      node->count++;
+
+      *parent->key(at - 1) = std::move(*left->key(left->count - 1));
+      left->key(left->count - 1)->~K();
+      left->count--;
+      return;
+    }
+
+    if (right and right->count > min_inner) {
+      ::new (node->key(node->count)) K(std::move(*parent->key(at)));
+      node->children[node->count + 1] = right->children[0];
+      node->count++;
+
+      *parent->key(at) = std::move(*right->key(0));
+      right->key(0)->~K();
+      for (usize i = 0; i + 1 < right->count; ++i) {
+        ::new (right->key(i)) K(std::move(*right->key(i + 1)));
+        right->key(i + 1)->~K();
+      }
+      for (usize i = 0; i < right->count; ++i) {
+        right->children[i] = right->children[i + 1];
+      }
+      right->count--;
+      return;
+    }
+
+    // the right one of the two empties into the left one, with the separator
+    // between them coming down from the parent in between
+    Inner* const into = left ? left : node;
+    Inner* const from = left ? node : right;
+    const usize gone = left ? at - 1 : at;
+
+    ::new (into->key(into->count)) K(std::move(*parent->key(gone)));
+    into->children[into->count + 1] = from->children[0];
+    into->count++;
+
+    for (usize i = 0; i < from->count; ++i) {
+      ::new (into->key(into->count)) K(std::move(*from->key(i)));
+      from->key(i)->~K();
+      into->children[into->count + 1] = from->children[i + 1];
+      into->count++;
+    }
+    from->count = 0;
+
+    remove_child(parent, gone);
+    free_inner(from);
+
+    fix_inner(path, level - 1);
+  }
+
+  template<
+    typename K,
+    typename V,
+    usize Fanout,
+    typename Compare,
+    typename Allocator>
+  auto BPlusTreeMap<K, V, Fanout, Compare, Allocator>::check(
+    const Base* node,
+    usize level,
+    const K* lo,
+    const K* hi,
+    const Leaf*& next
+  ) const -> bool {
+    const auto outside = [this, lo, hi](const K& key) {
+      return (lo and comp(key, *lo)) or (hi and not comp(key, *hi));
+    };
+
+    if (level + 1 == height) {
+      const Leaf* const leaf = static_cast<const Leaf*>(node);
+      if (leaf != next or leaf->count == 0 or leaf->count > Fanout or
+          (leaf != root and leaf != tail and leaf->count < min_leaf)) {
+        return false;
+      }
+      next = leaf->next;
+
+      for (usize i = 0; i < leaf->count; ++i) {
+        const K& key = leaf->slot(i)->key;
+        if (outside(key) or (i > 0 and not comp(leaf->slot(i - 1)->key, key))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    const Inner* const inner = static_cast<const Inner*>(node);
+    if (inner->count == 0 or inner->count > Fanout - 1 or
+        (inner != root and inner->count < min_inner)) {
+      return false;
+    }
+
+    for (usize i = 0; i < inner->count; ++i) {
+      const K& key = *inner->key(i);
+      if (outside(key) or (i > 0 and not comp(*inner->key(i - 1), key))) {
+        return false;
+      }
+    }
+
+    for (usize i = 0; i <= inner->count; ++i) {
+      const K* const low = i > 0 ? inner->key(i - 1) : lo;
+      const K* const high = i < inner->count ? inner->key(i) : hi;
+      if (not check(inner->children[i], level + 1, low, high, next)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+} // namespace CS280
+
+#endif
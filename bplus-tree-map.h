@@ -0,0 +1,703 @@
+#ifndef BPLUS_TREE_MAP_H
+#define BPLUS_TREE_MAP_H
+
+#include "types.h"
+
+#include <array>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace CS280 {
+
+  /**
+   * @brief B+ tree with the BSTmap interface. Inner nodes hold up to
+   * Fanout - 1 sorted separator keys and Fanout children, leaves hold up to
+   * Fanout key / value pairs in key order and are linked both ways, so
+   * iteration runs along the leaves without going back up the tree. Every
+   * node but the root is at least half full, except the last leaf: a key
+   * past the end of a full last leaf starts a new one on its own, so sorted
+   * inserts leave full leaves behind them.
+   *
+   * Keys within a node are searched by a linear count without branches for
+   * arithmetic keys (which compilers turn into vector compares), by binary
+   * search otherwise. Inserts and erases move pairs around inside and
+   * between leaves, which invalidates iterators and references
+   *
+   * @tparam K Key, must be move constructible
+   * @tparam V Value, must be move constructible
+   * @tparam Fanout Most children of an inner node and most pairs in a leaf
+   * @tparam Compare Strict weak ordering on keys
+   * @tparam Allocator Allocator for the key / value pairs, rebound to
+   * allocate whole nodes
+   */
+  template<
+    typename K,
+    typename V,
+    usize Fanout = 32,
+    typename Compare = std::less<K>,
+    typename Allocator = std::allocator<std::pair<const K, V>>>
+  class BPlusTreeMap {
+    static_assert(Fanout >= 4, "a B+ tree node needs room for 4 children");
+
+  public:
+
+    class iterator;
+    class const_iterator;
+
+    /**
+     * @class Node
+     * @brief Key and value, one slot of a leaf
+     */
+    class Node {
+    public:
+
+      /**
+       * @brief Builds the key from 'k' and the value from 'args'
+       */
+      template<typename KeyArg, typename... Args>
+      Node(std::in_place_t, KeyArg&& k, Args&&... args);
+
+      /**
+       * @brief Gets the key stored
+       */
+      auto Key() const -> const K&;
+
+      /**
+       * @brief Gets the value stored
+       */
+      auto Value() -> V&;
+
+      /**
+       * @brief Gets the value stored
+       */
+      auto Value() const -> const V&;
+
+      friend class BPlusTreeMap;
+
+    private:
+
+      /**
+       * @brief Key
+       */
+      K key;
+
+      /**
+       * @brief Value
+       */
+      V value;
+    };
+
+  private:
+
+    struct Leaf;
+
+  public:
+
+    /**
+     * @class iterator
+     * @brief Iterator for a non-const map, a leaf and a slot in it
+     */
+    class iterator {
+    public:
+
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Node;
+      using difference_type = std::ptrdiff_t;
+      using pointer = Node*;
+      using reference = Node&;
+
+      /**
+       * @brief Default / normal constructor
+       */
+      iterator(Leaf* l = nullptr, usize i = 0);
+
+      /**
+       * @brief Pre-increment, move to the next
+       */
+      auto operator++() -> iterator&;
+
+      /**
+       * @brief Post-increment, returns the current and after move to the next
+       */
+      auto operator++(int) -> iterator;
+
+      /**
+       * @brief Pre-decrement, move to the previous (end to the last)
+       */
+      auto operator--() -> iterator&;
+
+      /**
+       * @brief Post-decrement, returns the current and after move to the
+       * previous
+       */
+      auto operator--(int) -> iterator;
+
+      /**
+       * @brief Gets the inner node
+       */
+      [[nodiscard]] auto operator*() const -> Node&;
+
+      /**
+       * @brief Gets the inner node
+       */
+      auto operator->() const -> Node*;
+
+      /**
+       * @brief Checks if this and another iterator are not equal
+       */
+      [[nodiscard]] auto operator!=(const iterator& rhs) const -> bool;
+
+      /**
+       * @brief Checks if this and another iterator are equal
+       */
+      [[nodiscard]] auto operator==(const iterator& rhs) const -> bool;
+
+      friend class BPlusTreeMap;
+
+    private:
+
+      /**
+       * @brief Leaf the pair lives in
+       */
+      Leaf* leaf;
+
+      /**
+       * @brief Slot of the pair, the leaf size for end() (which is one past
+       * the last slot of the last leaf)
+       */
+      usize index;
+    };
+
+    /**
+     * @class const_iterator
+     * @brief Iterator for a const map
+     */
+    class const_iterator {
+    public:
+
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Node;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Node*;
+      using reference = const Node&;
+
+      /**
+       * @brief Default / normal constructor
+       */
+      const_iterator(const Leaf* l = nullptr, usize i = 0);
+
+      /**
+       * @brief Pre-increment
+       */
+      auto operator++() -> const_iterator&;
+
+      /**
+       * @brief Post-increment
+       */
+      auto operator++(int) -> const_iterator;
+
+      /**
+       * @brief Pre-decrement
+       */
+      auto operator--() -> const_iterator&;
+
+      /**
+       * @brief Post-decrement
+       */
+      auto operator--(int) -> const_iterator;
+
+      /**
+       * @brief Gets a reference to the inner node
+       */
+      auto operator*() const -> const Node&;
+
+      /**
+       * @brief Gets the inner node
+       */
+      auto operator->() const -> const Node*;
+
+      /**
+       * @brief Checks if this and another iter is not equal
+       */
+      auto operator!=(const const_iterator& rhs) const -> bool;
+
+      /**
+       * @brief Checks if this and another iter is equal
+       */
+      auto operator==(const const_iterator& rhs) const -> bool;
+
+      friend class BPlusTreeMap;
+
+    private:
+
+      /**
+       * @brief Leaf the pair lives in
+       */
+      const Leaf* leaf;
+
+      /**
+       * @brief Slot of the pair
+       */
+      usize index;
+    };
+
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    /**
+     * @brief Default constructor
+     */
+    BPlusTreeMap();
+
+    /**
+     * @brief Constructor with a comparator (and allocator)
+     */
+    explicit BPlusTreeMap(
+      const Compare& comp,
+      const Allocator& alloc = Allocator()
+    );
+
+    /**
+     * @brief Copy constructor, with the allocator rhs hands out for copies.
+     * The pairs are laid out bottom up in full leaves, O(n)
+     */
+    BPlusTreeMap(const BPlusTreeMap& rhs);
+
+    /**
+     * @brief Move constructor, 'from' is left empty
+     */
+    BPlusTreeMap(BPlusTreeMap&& from);
+
+    /**
+     * @brief Copy assignment
+     */
+    auto operator=(const BPlusTreeMap& rhs) -> BPlusTreeMap&;
+
+    /**
+     * @brief Move assignment, 'rhs' is left empty
+     */
+    auto operator=(BPlusTreeMap&& rhs) -> BPlusTreeMap&;
+
+    /**
+     * @brief Destructor
+     */
+    ~BPlusTreeMap();
+
+    /**
+     * @brief Gets the number of elements in the map
+     */
+    auto size() const -> usize;
+
+    /**
+     * @brief Checks if the map is empty
+     */
+    auto empty() const -> bool;
+
+    /**
+     * @brief Removes every element
+     */
+    auto clear() -> void;
+
+    /**
+     * @brief Gets the value of the given key, inserting a default value first
+     * if it is not there
+     */
+    auto operator[](const K& key) -> V&;
+
+    /**
+     * @brief Inserts the key with a value built from 'args' in its slot
+     * unless the key is already there, either way returns where it is. If
+     * building the value throws the map is left as it was
+     */
+    template<typename... Args>
+    auto try_emplace(const K& key, Args&&... args) -> std::pair<iterator, bool>;
+
+    auto begin() -> iterator;
+
+    auto end() -> iterator;
+
+    auto rbegin() -> reverse_iterator;
+
+    auto rend() -> reverse_iterator;
+
+    /**
+     * @brief Gets the element with the given key, or end()
+     */
+    auto find(const K& key) -> iterator;
+
+    /**
+     * @brief Gets the first element whose key is not less than the given key
+     */
+    auto lower_bound(const K& key) -> iterator;
+
+    /**
+     * @brief Gets the first element whose key is greater than the given key
+     */
+    auto upper_bound(const K& key) -> iterator;
+
+    /**
+     * @brief Erases the element, invalidates every iterator
+     */
+    auto erase(iterator it) -> void;
+
+    /**
+     * @brief Erases the element with the given key, returns how many were
+     * erased (0 or 1)
+     */
+    auto erase(const K& key) -> usize;
+
+    auto begin() const -> const_iterator;
+
+    auto end() const -> const_iterator;
+
+    auto rbegin() const -> const_reverse_iterator;
+
+    auto rend() const -> const_reverse_iterator;
+
+    /**
+     * @brief Gets the element with the given key, or end()
+     */
+    auto find(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is not less than the given key
+     */
+    auto lower_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is greater than the given key
+     */
+    auto upper_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Is the key in the map
+     */
+    auto contains(const K& key) const -> bool;
+
+    /**
+     * @brief Levels of the tree, 1 when the root is a leaf
+     */
+    auto depth() const -> usize;
+
+    /**
+     * @brief Checks the ordering, separators, fill of every node, leaf links
+     * and size
+     */
+    auto sanityCheck() const -> bool;
+
+  private:
+
+    /**
+     * @brief What inner nodes and leaves have in common
+     */
+    struct Base {
+      /**
+       * @brief Keys (inner) or pairs (leaf) in use
+       */
+      usize count{0};
+    };
+
+    /**
+     * @brief Up to Fanout pairs in key order, built in place
+     */
+    struct Leaf : Base {
+      /**
+       * @brief Gets the pair in slot i
+       */
+      auto slot(usize i) -> Node*;
+
+      /**
+       * @brief Gets the pair in slot i
+       */
+      auto slot(usize i) const -> const Node*;
+
+      /**
+       * @brief Leaf before this one, nullptr for the first
+       */
+      Leaf* prev{nullptr};
+
+      /**
+       * @brief Leaf after this one, nullptr for the last
+       */
+      Leaf* next{nullptr};
+
+      /**
+       * @brief Room for the pairs
+       */
+      alignas(Node) unsigned char bytes[Fanout * sizeof(Node)];
+    };
+
+    /**
+     * @brief Up to Fanout - 1 separators and one more child. Every key under
+     * child i + 1 is at least separator i, every key under child i is less
+     */
+    struct Inner : Base {
+      /**
+       * @brief Gets separator i
+       */
+      auto key(usize i) -> K*;
+
+      /**
+       * @brief Gets separator i
+       */
+      auto key(usize i) const -> const K*;
+
+      /**
+       * @brief Children, inner nodes or (on the last inner level) leaves
+       */
+      std::array<Base*, Fanout> children{};
+
+      /**
+       * @brief Room for the separators
+       */
+      alignas(K) unsigned char bytes[(Fanout - 1) * sizeof(K)];
+    };
+
+    /**
+     * @brief An inner node on the way down and the child taken there
+     */
+    struct Step {
+      Inner* node;
+      usize child;
+    };
+
+    /**
+     * @brief Steps of a descent from the root, by level
+     */
+    using Path = std::array<Step, 64>;
+
+    using leaf_allocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Leaf>;
+
+    using leaf_traits = std::allocator_traits<leaf_allocator>;
+
+    using inner_allocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Inner>;
+
+    using inner_traits = std::allocator_traits<inner_allocator>;
+
+    /**
+     * @brief Fewest pairs in a leaf other than the root
+     */
+    static constexpr usize min_leaf = Fanout / 2;
+
+    /**
+     * @brief Fewest separators in an inner node other than the root
+     */
+    static constexpr usize min_inner = (Fanout - 1) / 2;
+
+    /**
+     * @brief Are node keys counted one by one rather than binary searched
+     */
+    static constexpr bool linear = std::is_arithmetic_v<K>;
+
+    /**
+     * @brief Number of leading slots out of n for which 'past' holds, which
+     * must hold for a prefix of them
+     */
+    template<typename Past>
+    static auto count_past(usize n, Past past) -> usize;
+
+    /**
+     * @brief Child of 'node' whose keys the given key belongs with
+     */
+    auto route(const Inner* node, const K& key) const -> usize;
+
+    /**
+     * @brief Slots of the leaf whose keys are less than the given key
+     */
+    auto lower_in(const Leaf* leaf, const K& key) const -> usize;
+
+    /**
+     * @brief Slots of the leaf whose keys are not greater than the given key
+     */
+    auto upper_in(const Leaf* leaf, const K& key) const -> usize;
+
+    /**
+     * @brief Goes down to the leaf the key belongs in, noting every step
+     */
+    auto descend(const K& key, Path& path) const -> Leaf*;
+
+    /**
+     * @brief Goes down to the leaf the key belongs in
+     */
+    auto find_leaf(const K& key) const -> Leaf*;
+
+    /**
+     * @brief Position of the first key not less than the given key (greater
+     * if 'upper'), one past the last if there is none
+     */
+    auto bound(const K& key, bool upper) const -> iterator;
+
+    /**
+     * @brief Position of the given key, one past the last if it is not there
+     */
+    auto match(const K& key) const -> iterator;
+
+    /**
+     * @brief Position one past the last pair
+     */
+    auto past_end() const -> iterator;
+
+    /**
+     * @brief Allocates an empty leaf
+     */
+    auto make_leaf() -> Leaf*;
+
+    /**
+     * @brief Allocates an empty inner node
+     */
+    auto make_inner() -> Inner*;
+
+    /**
+     * @brief Frees a leaf whose pairs are gone
+     */
+    auto free_leaf(Leaf* leaf) -> void;
+
+    /**
+     * @brief Frees an inner node whose separators are gone
+     */
+    auto free_inner(Inner* node) -> void;
+
+    /**
+     * @brief Frees the subtree at 'node', which is 'level' levels below the
+     * root
+     */
+    auto destroy(Base* node, usize level) -> void;
+
+    /**
+     * @brief Moves the pairs from slot 'at' on one slot right, leaving 'at'
+     * free. The count stays as it was
+     */
+    static auto open(Leaf* leaf, usize at) -> void;
+
+    /**
+     * @brief Moves the pairs after slot 'at', which is free, one slot left.
+     * The count stays as it was
+     */
+    static auto close(Leaf* leaf, usize at) -> void;
+
+    /**
+     * @brief Moves 'n' pairs from slot 'from' of 'source' to the end of
+     * 'target'. The count of 'source' stays as it was
+     */
+    static auto move_pairs(Leaf* source, usize from, usize n, Leaf* target)
+      -> void;
+
+    /**
+     * @brief Builds a pair from 'key' and 'args' in slot 'index' of a leaf
+     * with room, moving the pairs from there on one slot right. If building
+     * it throws they move back
+     */
+    template<typename... Args>
+    auto emplace_at(Leaf* leaf, usize index, const K& key, Args&&... args)
+      -> void;
+
+    /**
+     * @brief Adds 'right' after the child taken at step 'above' - 1 of
+     * 'path', with 'separator' in front of it, splitting full nodes on the
+     * way up and the root last. The nodes the splits need are allocated
+     * before anything changes, so if that throws the tree is as it was
+     */
+    auto insert_child(Path& path, usize above, K separator, Base* right)
+      -> void;
+
+    /**
+     * @brief How many of 'total' nodes or pairs go in node 'i' of a level
+     * built bottom up, 'most' to a node but the last two sharing the rest
+     * when the last would have fewer than 'least'
+     */
+    static auto packed(usize total, usize most, usize least, usize i)
+      -> usize;
+
+    /**
+     * @brief Puts separator 'at' and child 'at' + 1 in a node with room
+     */
+    static auto place_child(Inner* node, usize at, K&& separator, Base* right)
+      -> void;
+
+    /**
+     * @brief Removes separator 'at' and child 'at' + 1 from 'node'
+     */
+    static auto remove_child(Inner* node, usize at) -> void;
+
+    /**
+     * @brief Erases slot 'index' of 'leaf', reached through 'path'
+     */
+    auto erase_slot(Path& path, Leaf* leaf, usize index) -> void;
+
+    /**
+     * @brief Tops up the leaf at the end of 'path' that fell below half full
+     * from a sibling, or merges the two
+     */
+    auto fix_leaf(Path& path, Leaf* leaf) -> void;
+
+    /**
+     * @brief Same for the inner node at step 'level' of 'path', which just
+     * lost a separator, then for its parent if a merge takes one from it
+     */
+    auto fix_inner(Path& path, usize level) -> void;
+
+    /**
+     * @brief Checks the subtree at 'node' on 'level', whose keys must lie in
+     * [lo, hi) (either may be missing). 'next' is the leaf the links say
+     * comes next, and moves on past the leaves of the subtree
+     */
+    auto check(
+      const Base* node,
+      usize level,
+      const K* lo,
+      const K* hi,
+      const Leaf*& next
+    ) const -> bool;
+
+    /**
+     * @brief Key ordering
+     */
+    Compare comp;
+
+    /**
+     * @brief Allocates the leaves
+     */
+    leaf_allocator leaves;
+
+    /**
+     * @brief Allocates the inner nodes
+     */
+    inner_allocator inners;
+
+    /**
+     * @brief Root, nullptr when empty
+     */
+    Base* root = nullptr;
+
+    /**
+     * @brief First leaf, where begin() is
+     */
+    Leaf* head = nullptr;
+
+    /**
+     * @brief Last leaf, end() is one past its last slot
+     */
+    Leaf* tail = nullptr;
+
+    /**
+     * @brief Levels, 0 when empty and 1 when the root is a leaf
+     */
+    usize height = 0;
+
+    /**
+     * @brief Size of the map
+     */
+    usize count = 0;
+  };
+} // namespace CS280
+
+#ifndef BPLUS_TREE_MAP_CPP
+#include "bplus-tree-map.cpp"
+#endif
+#endif
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <type_traits>
 #include <utility>
 #ifndef BSTMAP_H
 #include "bst-map.h"
@@ -11,21 +12,29 @@
 
 namespace CS280 {
 
-  // static data members
-  template<typename K, typename V>
-  const typename BSTmap<K, V>::iterator BSTmap<K, V>::end_it{
-    nullptr,
-  };
-
-  template<typename K, typename V>
-  const typename BSTmap<K, V>::const_iterator BSTmap<K, V>::const_end_it{
-    nullptr,
-  };
-
-  template<typename K, typename V>
-  BSTmap<K, V>::Node::Node(
-    K key,
-    V value,
+  template<typename K>
+  auto SubtreeSize::leaf(const K&) const -> usize {
+    return 1;
+  }
+
+  inline auto SubtreeSize::identity() const -> usize {
+    return 0;
+  }
+
+  inline auto SubtreeSize::combine(usize lhs, usize rhs) const -> usize {
+    return lhs + rhs;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::Node(
+    const K& key,
+    const V& value,
     Node* parent,
     usize height,
     i32 balance,
@@ -37,40 +46,108 @@ namespace CS280 {
       parent{parent},
       height{height},
       balance{balance},
+      aggregate{},
       left{left},
       right{right} {}
 
-  template<typename K, typename V>
-  BSTmap<K, V>::Node::~Node() {
-    delete left;
-    delete right;
-  }
-
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::clone() const -> Node* {
-    return new Node{
-      key,
-      value,
-      parent,
-      height,
-      balance,
-      left ? left->clone() : left,
-      right ? right->clone() : right
-    };
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename KeyArg, typename... Args>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::Node(
+    std::in_place_t,
+    Node* parent,
+    KeyArg&& key,
+    Args&&... args
+  ):
+      key(std::forward<KeyArg>(key)),
+      value(std::forward<Args>(args)...),
+      parent{parent},
+      height{0},
+      balance{0},
+      aggregate{} {
+    if constexpr (augmented) {
+      aggregate = leaf_aggregate(this->key, this->value);
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::Node(HeaderTag):
+      parent{this},
+      height{header_height},
+      balance{0},
+      aggregate{},
+      left{this},
+      right{this} {}
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::~Node() {
+    if (not is_header()) {
+      key.~K();
+      value.~V();
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::is_header() const
+    -> bool {
+    return height == header_height;
   }
 
-  template<typename K, typename V>
-  const K& BSTmap<K, V>::Node::Key() const {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  const K& BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::Key() const {
     return key;
   }
 
-  template<typename K, typename V>
-  V& BSTmap<K, V>::Node::Value() {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::Value()
+    -> value_reference {
     return value;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::first() -> Node* {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::first()
+    -> Node* {
     Node* node = this;
 
     while (node->left) {
@@ -80,8 +157,15 @@ namespace CS280 {
     return node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::last() -> Node* {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::last()
+    -> Node* {
     Node* node = this;
 
     while (node->right) {
@@ -91,16 +175,25 @@ namespace CS280 {
     return node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::successor() -> Node* {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::successor()
+    -> Node* {
     if (right != nullptr) {
       return right->first();
     }
 
+    // no null checks, the climb from the greatest node stops at the header
+    // (whose right is the greatest node, and whose parent is itself)
     Node* current = this;
     Node* prev = current->parent;
 
-    while (prev and current == prev->right) {
+    while (current == prev->right) {
       current = prev;
       prev = prev->parent;
     }
@@ -108,477 +201,3203 @@ namespace CS280 {
     return prev;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::decrement() -> Node* {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::decrement()
+    -> Node* {
+    // end() steps back to the greatest node
+    if (is_header()) {
+      return right;
+    }
+
     if (left) {
       return left->last();
     }
 
     Node* current = this;
-    while (current->parent and current == current->parent->left) {
+    while (current == current->parent->left) {
       current = current->parent;
     }
 
-    Node* predecessor = current->parent;
-
-    return (predecessor and predecessor->key == key) ? nullptr : predecessor;
+    return current->parent;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::recalc_height() -> void {
-    height = 0;
-
-    if (left) {
-      height = left->height + 1;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::recalc_height()
+    -> usize {
+    usize touched = 0;
+
+    // ancestors only look at the height, once it holds still they are done
+    // (aggregates change all the way up, so augmented trees keep going)
+    for (Node* node = this; not node->is_header(); node = node->parent) {
+      const usize before = node->height;
+
+      node->refresh();
+      touched++;
+
+      if (node->height == before and not augmented) {
+        break;
+      }
     }
 
-    if (right) {
-      height = std::max(height, right->height + 1);
+    return touched;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::refresh()
+    -> void {
+    const usize left_height = left ? left->height + 1 : 0;
+    const usize right_height = right ? right->height + 1 : 0;
+
+    height = std::max(left_height, right_height);
+
+    if constexpr (not std::is_same_v<Balance, RedBlack>) {
+      balance = static_cast<i32>(right_height) - static_cast<i32>(left_height);
     }
 
-    if (parent) {
-      parent->recalc_height();
+    if constexpr (augmented) {
+      const Augment augment{};
+
+      aggregate = leaf_aggregate(key, value);
+      if (left) {
+        aggregate = augment.combine(left->aggregate, aggregate);
+      }
+      if (right) {
+        aggregate = augment.combine(aggregate, right->aggregate);
+      }
     }
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::add_child(K key, V value) -> Node& {
-    Node* node = new Node{
-      std::move(key),
-      std::move(value),
-      this, // parent
-      0,
-      0,
-      nullptr, // left
-      nullptr, // right
-    };
-
-    if (key < this->key) {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::add_child(
+    Node* node,
+    bool on_left
+  ) -> Node& {
+    node->parent = this;
+
+    if (on_left) {
       left = node;
     } else {
       right = node;
     }
 
-    node->recalc_height();
-
     return *node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::Node::print(std::ostream& os) const -> void {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Node::print(
+    std::ostream& os
+  ) const -> void {
     os << value;
   }
 
-  template<typename K, typename V>
-  BSTmap<K, V>::iterator::iterator(Node* node): node{node} {}
-
-  template<typename K, typename V>
-  auto BSTmap<K, V>::iterator::operator++() -> iterator& {
-    if (node == nullptr) {
-      return *this;
-    }
-
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::iterator(
+    Node* node
+  ):
+      node{node} {}
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator++()
+    -> iterator& {
     node = node->successor();
 
     return *this;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::iterator::operator++(int) -> iterator {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator++(
+    int
+  ) -> iterator {
     iterator iter{*this};
     operator++();
     return iter;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::iterator::operator*() const -> Node& {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator--()
+    -> iterator& {
+    node = node->decrement();
+
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator--(
+    int
+  ) -> iterator {
+    iterator iter{*this};
+    operator--();
+    return iter;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator*() const
+    -> Node& {
     return *node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::iterator::operator->() const -> Node* {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator->() const
+    -> Node* {
     return node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::iterator::operator!=(const iterator& rhs) const -> bool {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator!=( //
+    const iterator& rhs
+  ) const -> bool {
     return node != rhs.node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::iterator::operator==(const iterator& rhs) const -> bool {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::iterator::operator==( //
+    const iterator& rhs
+  ) const -> bool {
     return node == rhs.node;
   }
 
-  template<typename K, typename V>
-  BSTmap<K, V>::const_iterator::const_iterator(Node* p): node{p} {}
-
-  template<typename K, typename V>
-  auto BSTmap<K, V>::const_iterator::operator++() -> const_iterator& {
-    if (node == nullptr) {
-      return *this;
-    }
-
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::const_iterator(
+    Node* p
+  ):
+      node{p} {}
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator++()
+    -> const_iterator& {
     node = node->successor();
 
     return *this;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::const_iterator::operator++(int) -> const_iterator {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator++(
+    int
+  ) -> const_iterator {
     const_iterator iter{*this};
     operator++();
     return iter;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::const_iterator::operator*() const -> const Node& {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator--()
+    -> const_iterator& {
+    node = node->decrement();
+
+    return *this;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator--(
+    int
+  ) -> const_iterator {
+    const_iterator iter{*this};
+    operator--();
+    return iter;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator*() const
+    -> const Node& {
     return *node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::const_iterator::operator->() const -> const Node* {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator->() const
+    -> const Node* {
     return node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::const_iterator::operator!=( //
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator!=( //
     const const_iterator& rhs
   ) const -> bool {
     return node != rhs.node;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::const_iterator::operator==( //
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::const_iterator::operator==( //
     const const_iterator& rhs
   ) const -> bool {
     return node == rhs.node;
   }
 
-  template<typename K, typename V>
-  BSTmap<K, V>::BSTmap(): root{nullptr}, count{0} {}
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::BSTmap():
+      comp{},
+      alloc{},
+      header{typename Node::HeaderTag{}},
+      root{nullptr},
+      count{0} {}
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::BSTmap(
+    const Compare& comp,
+    const Allocator& alloc
+  ):
+      comp{comp},
+      alloc{alloc},
+      header{typename Node::HeaderTag{}},
+      root{nullptr},
+      count{0} {}
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename InputIt>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::BSTmap(
+    InputIt first,
+    InputIt last,
+    const Compare& comp,
+    const Allocator& alloc
+  ):
+      comp{comp},
+      alloc{alloc},
+      header{typename Node::HeaderTag{}},
+      root{nullptr},
+      count{0} {
+    assign(first, last);
+  }
 
-  template<typename K, typename V>
-  BSTmap<K, V>& BSTmap<K, V>::operator=(const BSTmap& rhs) {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::operator=(
+    const BSTmap& rhs
+  ) -> BSTmap& {
     if (&rhs == this) {
       return *this;
     }
 
-    delete root;
+    clear();
+    reserve_nodes(rhs.count);
 
+    comp = rhs.comp;
+    root = clone(rhs.root);
+    reset_header();
     count = rhs.count;
-    root = rhs.root ? rhs.root->clone() : rhs.root;
 
     return *this;
   }
 
-  template<typename K, typename V>
-  BSTmap<K, V>& BSTmap<K, V>::operator=(BSTmap&& from) {
-    delete root;
-
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::operator=(
+    BSTmap&& from
+  ) -> BSTmap& {
+    clear();
+
+    // the nodes stay with the allocator that made them
+    comp = from.comp;
+    alloc = from.alloc;
     count = std::exchange(from.count, 0);
     root = std::exchange(from.root, nullptr);
+    reset_header();
+    from.reset_header();
 
     return *this;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::size() -> usize {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::size() -> usize {
     return count;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::empty() -> bool {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::height() const
+    -> usize {
+    return root ? root->height + 1 : 0;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::depth(
+    const_iterator it
+  ) const -> usize {
+    return getdepth(*it.node);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::statistics() const
+    -> const Stats& {
+    return stats;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::reset_statistics()
+    -> void {
+    stats = Stats{};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::empty() -> bool {
     return count == 0;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::operator[](const K& key) -> V& {
-    if (empty()) {
-      root = new Node{
-        key,     // key
-        V{},     // default value
-        nullptr, // parent
-        0,       // height
-        0,       // balance
-        nullptr, // left
-        nullptr, // right
-      };
-      count++;
-      return root->value;
-    }
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::operator[](
+    const K& key
+  ) -> V& {
+    static_assert(
+      not value_augmented,
+      "operator[] would leave the aggregates stale, use insert_or_assign"
+    );
+
+    return try_emplace_node(key).first->value;
+  }
 
-    Node* node = index(root, key);
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::operator[](K&& key)
+    -> V& {
+    static_assert(
+      not value_augmented,
+      "operator[] would leave the aggregates stale, use insert_or_assign"
+    );
+
+    return try_emplace_node(std::move(key)).first->value;
+  }
 
-    // proper node found
-    if (node->key == key) {
-      return node->value;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename... Args>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::emplace(
+    Args&&... args
+  ) -> std::pair<iterator, bool> {
+    Node* const node =
+      create_node(std::in_place, nullptr, std::forward<Args>(args)...);
+
+    const Descent descent = index(node->key);
+
+    if (is_match(descent.bound, node->key)) {
+      destroy_node(node);
+      return {iterator{descent.bound}, false};
     }
 
-    count++;
-    return node->add_child(std::move(key), V{}).value;
+    attach(node, descent.parent, descent.bound == descent.parent);
+    return {iterator{node}, true};
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::index(Node* node, const K& key) const -> Node* {
-    if (node == nullptr) {
-      return nullptr;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename... Args>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::try_emplace(
+    const K& key,
+    Args&&... args
+  ) -> std::pair<iterator, bool> {
+    const auto [node, inserted] =
+      try_emplace_node(key, std::forward<Args>(args)...);
+
+    return {iterator{node}, inserted};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename... Args>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::try_emplace(
+    K&& key,
+    Args&&... args
+  ) -> std::pair<iterator, bool> {
+    const auto [node, inserted] =
+      try_emplace_node(std::move(key), std::forward<Args>(args)...);
+
+    return {iterator{node}, inserted};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename M>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::insert_or_assign(
+    const K& key,
+    M&& obj
+  ) -> std::pair<iterator, bool> {
+    // obj is only forwarded into a new node, so it is still untouched if the
+    // key was already there
+    const auto [node, inserted] = try_emplace_node(key, std::forward<M>(obj));
+
+    if (not inserted) {
+      node->value = std::forward<M>(obj);
+      reaggregate(node);
     }
 
-    if (node->key == key) {
-      return node;
+    return {iterator{node}, inserted};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename M>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::insert_or_assign(
+    K&& key,
+    M&& obj
+  ) -> std::pair<iterator, bool> {
+    const auto [node, inserted] =
+      try_emplace_node(std::move(key), std::forward<M>(obj));
+
+    if (not inserted) {
+      node->value = std::forward<M>(obj);
+      reaggregate(node);
     }
 
-    // if on left
-    if (key < node->key) {
+    return {iterator{node}, inserted};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Pairs>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::insert_batch(
+    const Pairs& pairs
+  ) -> usize {
+    // a stable sort keeps equal keys in order, so the first one still wins
+    std::vector<std::pair<K, V>> batch(std::begin(pairs), std::end(pairs));
+    std::stable_sort(
+      batch.begin(),
+      batch.end(),
+      [this](const auto& lhs, const auto& rhs) {
+        return comp(lhs.first, rhs.first);
+      }
+    );
+
+    reserve_nodes(batch.size());
 
-      // if no left, return parent
-      if (node->left == nullptr) {
-        return node;
+    usize inserted = 0;
+    Node* finger = root;
+    Node* bounds[batch_lanes];
+
+    for (usize start = 0; start < batch.size(); start += batch_lanes) {
+      const usize lanes = std::min(batch_lanes, batch.size() - start);
+
+      // keys already there drop out here, and the paths of the others are
+      // in the cache by the time they are linked in one by one
+      lower_bounds(
+        lanes,
+        [&](usize lane) -> const K& { return batch[start + lane].first; },
+        bounds
+      );
+
+      for (usize lane = 0; lane < lanes; ++lane) {
+        auto& [key, value] = batch[start + lane];
+
+        if (is_match(bounds[lane], key)) {
+          finger = bounds[lane];
+          continue;
+        }
+
+        // an earlier key of the group may have been the same one
+        const Descent descent = index(key, climb(finger, key));
+
+        if (is_match(descent.bound, key)) {
+          finger = descent.bound;
+          continue;
+        }
+
+        Node* const node = create_node(
+          std::in_place,
+          descent.parent,
+          std::move(key),
+          std::move(value)
+        );
+        attach(node, descent.parent, descent.bound == descent.parent);
+
+        // rotations may move it, but its subtree still holds the key's place
+        finger = node;
+        inserted++;
       }
+    }
+
+    return inserted;
+  }
 
-      return index(node->left, key);
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Keys, typename Out>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find_batch(
+    const Keys& keys,
+    Out out
+  ) -> Out {
+    for (Node* const node: find_batch_nodes(keys)) {
+      *out++ = node ? iterator{node} : end();
     }
 
-    // if on right
+    return out;
+  }
 
-    // if right is none, reutnr parent
-    if (node->right == nullptr) {
-      return node;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Keys, typename Out>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find_batch(
+    const Keys& keys,
+    Out out
+  ) const -> Out {
+    for (Node* const node: find_batch_nodes(keys)) {
+      *out++ = node ? const_iterator{node} : end();
     }
 
-    return index(node->right, key);
+    return out;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::leaf_aggregate(
+    const K& key,
+    const V& value
+  ) -> typename Augment::value_type {
+    if constexpr (has_key_leaf<Augment, K>::value) {
+      return Augment{}.leaf(key);
+    } else {
+      return Augment{}.leaf(key, value);
+    }
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::end() -> iterator {
-    return end_it;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::reaggregate(
+    Node* node
+  ) -> void {
+    if constexpr (value_augmented) {
+      // the heights hold still, but augmented trees refresh up to the root
+      node->recalc_height();
+    }
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::find(const K& key) -> iterator {
-    Node* node = index(root, key);
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename KeyArg, typename... Args>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::try_emplace_node(
+    KeyArg&& key,
+    Args&&... args
+  ) -> std::pair<Node*, bool> {
+    const Descent descent =
+      std::is_same_v<Balance, Splay> ? search(key) : index(key);
+
+    // proper node found
+    if (is_match(descent.bound, key)) {
+      if constexpr (std::is_same_v<Balance, Splay>) {
+        splay(descent.bound);
+      }
+      return {descent.bound, false};
+    }
+
+    Node* const node = create_node(
+      std::in_place,
+      descent.parent,
+      std::forward<KeyArg>(key),
+      std::forward<Args>(args)...
+    );
 
-    return (node and node->key == key) ? iterator{node} : end();
+    // the descent only turns left at nodes it records as the bound
+    attach(node, descent.parent, descent.bound == descent.parent);
+    return {node, true};
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::erase(iterator it) -> void {
-    if (it == end()) {
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::attach(
+    Node* node,
+    Node* parent,
+    bool on_left
+  ) -> void {
+    count++;
+
+    if (parent == nullptr) {
+      root = node;
+      node->parent = &header;
+      header.left = node;
+      header.right = node;
       return;
     }
 
-    count--;
-
-    Node* const to_erase = it.node;
+    if (parent == header.left and on_left) {
+      header.left = node;
+    }
 
-    Node* const parent = to_erase->parent;
+    if (parent == header.right and not on_left) {
+      header.right = node;
+    }
 
-    Node* left = std::exchange(to_erase->left, nullptr);
-    Node* right = std::exchange(to_erase->right, nullptr);
+    parent->add_child(node, on_left);
 
-    if (not parent and not left and not right) {
-      root = nullptr;
-      delete to_erase;
+    // every ancestor ends up below the new node, refreshed as it is rotated
+    // down, so there are no heights to fix first
+    if constexpr (std::is_same_v<Balance, Splay>) {
+      splay(node);
       return;
     }
 
-    if (parent == nullptr) {
-      delete to_erase;
-      Node* other = nullptr;
+    rebalance(parent);
 
-      if (left) {
-        root = left;
-        other = right;
+    if constexpr (std::is_same_v<Balance, RedBlack>) {
+      node->balance = red;
+      fix_red_insert(node);
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::index(
+    const Key& key
+  ) const -> Descent {
+    return index(key, root);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::index(
+    const Key& key,
+    Node* from
+  ) const -> Descent {
+    Node* parent = nullptr;
+    Node* bound = nullptr;
+
+    // one comparison per level and no early exit, the outcome only picks the
+    // next pointer so the loop body has no data dependent branch to miss
+    for (Node* node = from; node;) {
+      const bool less = comp(node->key, key);
+
+      parent = node;
+      bound = less ? bound : node;
+      node = less ? node->right : node->left;
+    }
+
+    return {parent, bound};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::search(
+    const Key& key
+  ) const -> Descent {
+    Node* parent = nullptr;
+    Node* bound = nullptr;
+
+    for (Node* node = root; node;) {
+      parent = node;
+
+      if (comp(node->key, key)) {
+        node = node->right;
+      } else if (comp(key, node->key)) {
+        bound = node;
+        node = node->left;
       } else {
-        root = right;
-        other = left;
+        return {node, node};
       }
-      root->parent = nullptr;
+    }
+
+    return {parent, bound};
+  }
 
-      if (other == nullptr) {
-        return;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::climb(
+    Node* finger,
+    const Key& key
+  ) const -> Node* {
+    Node* node = finger;
+
+    // every node up to here holds keys above the last lookup, the subtree is
+    // only too small when the key reaches the ancestor it hangs left of
+    while (node != root) {
+      Node* const parent = node->parent;
+
+      if (node == parent->left and comp(key, parent->key)) {
+        break;
       }
 
-      Node* other_parent = index(root, other->key);
+      node = parent;
+    }
 
-      other->parent = other_parent;
-      if (other_parent->key > other->key) {
-        other_parent->left = other;
-      } else {
-        other_parent->right = other;
-      }
-      other->recalc_height();
+    return node;
+  }
 
-      return;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Keys>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find_batch_nodes(
+    const Keys& keys
+  ) const -> std::vector<Node*> {
+    using Key = std::decay_t<decltype(*std::begin(keys))>;
+
+    // sorted by key, remembering where each one goes in the output
+    std::vector<std::pair<const Key*, usize>> order;
+    for (const Key& key: keys) {
+      order.emplace_back(&key, order.size());
     }
 
-    // erase node from parent's
-    if (parent->left == to_erase) {
-      parent->left = nullptr;
-    } else {
-      parent->right = nullptr;
+    std::sort(
+      order.begin(),
+      order.end(),
+      [this](const auto& lhs, const auto& rhs) {
+        return comp(*lhs.first, *rhs.first);
+      }
+    );
+
+    std::vector<Node*> found(order.size(), nullptr);
+    Node* bounds[batch_lanes];
+
+    for (usize start = 0; start < order.size(); start += batch_lanes) {
+      const usize lanes = std::min(batch_lanes, order.size() - start);
+
+      lower_bounds(
+        lanes,
+        [&](usize lane) -> const Key& { return *order[start + lane].first; },
+        bounds
+      );
+
+      for (usize lane = 0; lane < lanes; ++lane) {
+        const auto& [key, position] = order[start + lane];
+
+        if (is_match(bounds[lane], *key)) {
+          found[position] = bounds[lane];
+        }
+      }
     }
 
-    delete to_erase;
+    return found;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename KeyAt>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::lower_bounds(
+    usize lanes,
+    KeyAt key_at,
+    Node** bounds
+  ) const -> void {
+    Node* node = root;
+    Node* bound = nullptr;
+
+    // the first and last keys bracket the rest, where they go the same way
+    // so does the whole group
+    while (node) {
+      const bool first_less = comp(node->key, key_at(0));
+
+      if (first_less != comp(node->key, key_at(lanes - 1))) {
+        break;
+      }
 
-    if (left == nullptr and right == nullptr) {
-      parent->recalc_height();
-      return;
+      bound = first_less ? bound : node;
+      node = first_less ? node->right : node->left;
     }
 
-    if (left) {
-      Node* left_parent = index(parent, left->key);
-      left->parent = left_parent;
-      if (left_parent->key > left->key) {
-        left_parent->left = left;
-      } else {
-        left_parent->right = left;
+    Node* nodes[batch_lanes];
+    for (usize lane = 0; lane < lanes; ++lane) {
+      nodes[lane] = node;
+      bounds[lane] = bound;
+    }
+
+    // the same step as index for every lane still going, a round at a time
+    for (bool going = node != nullptr; going;) {
+      going = false;
+
+      for (usize lane = 0; lane < lanes; ++lane) {
+        Node* const current = nodes[lane];
+
+        if (current) {
+          const bool less = comp(current->key, key_at(lane));
+
+          bounds[lane] = less ? bounds[lane] : current;
+          nodes[lane] = less ? current->right : current->left;
+          going = true;
+        }
       }
-      left->recalc_height();
     }
+  }
 
-    if (right) {
-      Node* right_parent = index(parent, right->key);
-      right->parent = right_parent;
-      if (right_parent->key > right->key) {
-        right_parent->left = right;
-      } else {
-        right_parent->right = right;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::is_match(
+    const Node* bound,
+    const Key& key
+  ) const -> bool {
+    // the bound is already known not to be less than the key
+    return bound and not comp(key, bound->key);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find_node(
+    const Key& key
+  ) const -> Node* {
+    Node* const bound = lower_bound_node(key);
+
+    return is_match(bound, key) ? bound : nullptr;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::access(
+    const Key& key
+  ) -> Node* {
+    if constexpr (std::is_same_v<Balance, Splay>) {
+      const Descent descent = search(key);
+      Node* const node = is_match(descent.bound, key) ? descent.bound : nullptr;
+
+      // a miss still pays for its path, bringing up the node it ended at
+      // keeps runs of misses amortized O(log n) as well
+      if (descent.parent) {
+        splay(node ? node : descent.parent);
       }
 
-      right->recalc_height();
+      return node;
+    } else {
+      return find_node(key);
     }
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::begin() const -> const_iterator {
-    return root ? const_iterator{root->first()} : end();
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::lower_bound_node(
+    const Key& key
+  ) const -> Node* {
+    return index(key).bound;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::end() const -> const_iterator {
-    return end_it;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::upper_bound_node(
+    const Key& key
+  ) const -> Node* {
+    Node* bound = nullptr;
+
+    // same descent as index, the bound is the first key greater instead
+    for (Node* node = root; node;) {
+      const bool greater = comp(key, node->key);
+
+      bound = greater ? node : bound;
+      node = greater ? node->left : node->right;
+    }
+
+    return bound;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::find(const K& key) const -> const_iterator {
-    Node* node = index(root, key);
-    return (node and node->key == key) ? iterator{node} : end();
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::end() -> iterator {
+    return iterator{&header};
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::sanityCheck() -> bool {
-    return true;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rbegin()
+    -> reverse_iterator {
+    return reverse_iterator{end()};
   }
 
-  template<typename K, typename V>
-  BSTmap<K, V>::BSTmap(const BSTmap& rhs):
-      root{
-        rhs.root ? rhs.root->clone() : nullptr,
-      },
-      count{rhs.count} {}
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rend()
+    -> reverse_iterator {
+    return reverse_iterator{begin()};
+  }
 
-  template<typename K, typename V>
-  BSTmap<K, V>::BSTmap(BSTmap&& from):
-      root{std::exchange(from.root, nullptr)},
-      count{std::exchange(from.count, 0)} {}
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::front() -> Node& {
+    return *header.left;
+  }
 
-  template<typename K, typename V>
-  BSTmap<K, V>::~BSTmap() {
-    delete root;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::back() -> Node& {
+    return *header.right;
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::begin() -> iterator {
-    return root ? iterator{root->first()} : end();
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find(const K& key)
+    -> iterator {
+    Node* const node = access(key);
+
+    return node ? iterator{node} : end();
   }
 
-  ////////////////////////////////////////////////////////////
-  // do not change this code from here to the end of the file
-  /* figure out whether node is left or right child or root
-   * used in print_backwards_padded
-   */
-  template<typename K, typename V>
-  auto BSTmap<K, V>::getedgesymbol(const Node* node) const -> char {
-    const Node* parent = node->parent;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find(const Key& key)
+    -> iterator {
+    Node* const node = access(key);
+
+    return node ? iterator{node} : end();
+  }
 
-    if (parent == nullptr) {
-      return '-';
-    }
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::contains(
+    const K& key
+  ) const -> bool {
+    return find_node(key) != nullptr;
+  }
 
-    return parent->left == node ? '\\' : '/';
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::contains(
+    const Key& key
+  ) const -> bool {
+    return find_node(key) != nullptr;
   }
 
-  /* this is another "ASCII-graphical" print, but using
-   * iterative function.
-   * Left branch of the tree is at the bottom
-   */
-  template<typename K, typename V>
-  auto operator<<(std::ostream& os, const BSTmap<K, V>& map) -> std::ostream& {
-    map.print(os);
-    return os;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::freeze() const
+    -> FrozenBSTmap<K, V, Compare> {
+    using Frozen = FrozenBSTmap<K, V, Compare>;
+
+    std::vector<typename Frozen::Node> sorted;
+    sorted.reserve(count);
+    for (Node* node = header.left; node != &header;
+         node = node->successor()) {
+      sorted.emplace_back(node->key, node->value);
+    }
+
+    return Frozen{std::move(sorted), comp};
   }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::print(std::ostream& os, bool print_value) const -> void {
-    if (root) {
-      BSTmap<K, V>::Node* b = root->last();
-      while (b) {
-        int depth = getdepth(*b);
-        int i;
-        /* printf(b); */
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::freeze_eytzinger()
+    const -> EytzingerBSTmap<K, V, Compare> {
+    using Frozen = EytzingerBSTmap<K, V, Compare>;
+
+    std::vector<typename Frozen::Node> sorted;
+    sorted.reserve(count);
+    for (Node* node = header.left; node != &header;
+         node = node->successor()) {
+      sorted.emplace_back(node->key, node->value);
+    }
 
-        char edge = getedgesymbol(b);
-        switch (edge) {
-          case '-':
-            for (i = 0; i < depth; ++i) {
-              std::printf("       ");
-            }
-            os << b->key;
-            if (print_value) {
-              os << " -> " << b->value;
-            }
-            os << std::endl;
-            break;
-          case '\\':
-            for (i = 0; i < depth; ++i) {
-              std::printf("       ");
-            }
-            os << edge << std::endl;
-            for (i = 0; i < depth; ++i) {
-              std::printf("       ");
-            }
-            os << b->key;
-            if (print_value) {
-              os << " -> " << b->value;
-            }
-            os << std::endl;
-            break;
-          case '/':
-            for (i = 0; i < depth; ++i) {
-              std::printf("       ");
-            }
-            os << b->key;
-            if (print_value) {
-              os << " -> " << b->value;
-            }
-            os << std::endl;
-            for (i = 0; i < depth; ++i) {
-              std::printf("       ");
-            }
-            os << edge << std::endl;
-            break;
-        }
-        b = b->decrement();
+    return Frozen{std::move(sorted), comp};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::aggregate(
+    const K& lo,
+    const K& hi
+  ) const -> typename Augment::value_type {
+    static_assert(augmented, "aggregate needs an Augment policy");
+
+    const Augment augment{};
+
+    // highest node inside the window, everything else in it hangs below
+    const Node* split = root;
+    while (split) {
+      if (comp(split->key, lo)) {
+        split = split->right;
+      } else if (not comp(split->key, hi)) {
+        split = split->left;
+      } else {
+        break;
       }
     }
-    std::printf("\n");
-  }
 
-  template<typename K, typename V>
-  auto BSTmap<K, V>::getdepth(const Node& node) const -> usize {
-    return root->height - node.height;
+    if (split == nullptr) {
+      return augment.identity();
+    }
+
+    typename Augment::value_type total =
+      leaf_aggregate(split->key, split->value);
+
+    // left of the split only lo can cut a subtree, every node not below lo
+    // comes with its whole right subtree (and each one is further left)
+    for (const Node* node = split->left; node;) {
+      if (comp(node->key, lo)) {
+        node = node->right;
+        continue;
+      }
+
+      typename Augment::value_type part =
+        leaf_aggregate(node->key, node->value);
+      if (node->right) {
+        part = augment.combine(part, node->right->aggregate);
+      }
+      total = augment.combine(part, total);
+      node = node->left;
+    }
+
+    // and mirrored on the right, where only hi can cut
+    for (const Node* node = split->right; node;) {
+      if (not comp(node->key, hi)) {
+        node = node->left;
+        continue;
+      }
+
+      if (node->left) {
+        total = augment.combine(total, node->left->aggregate);
+      }
+      total = augment.combine(total, leaf_aggregate(node->key, node->value));
+      node = node->right;
+    }
+
+    return total;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rank(
+    const K& key
+  ) const -> usize {
+    static_assert(
+      std::is_same_v<Augment, SubtreeSize>,
+      "rank needs the SubtreeSize augmentation"
+    );
+
+    usize less = 0;
+
+    // every step right skips a left subtree and the node above it
+    for (const Node* node = root; node;) {
+      if (comp(node->key, key)) {
+        less += subtree_size(node->left) + 1;
+        node = node->right;
+      } else {
+        node = node->left;
+      }
+    }
+
+    return less;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::select(
+    usize index
+  ) -> iterator {
+    Node* const node = select_node(index);
+
+    return node ? iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::select(
+    usize index
+  ) const -> const_iterator {
+    Node* const node = select_node(index);
+
+    return node ? const_iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::subtree_size(
+    const Node* node
+  ) -> usize {
+    return node ? node->aggregate : 0;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::select_node(
+    usize index
+  ) const -> Node* {
+    static_assert(
+      std::is_same_v<Augment, SubtreeSize>,
+      "select needs the SubtreeSize augmentation"
+    );
+
+    Node* node = root;
+
+    // the size of the left subtree says which side the position is on
+    while (node) {
+      const usize left = subtree_size(node->left);
+
+      if (index < left) {
+        node = node->left;
+      } else if (index == left) {
+        return node;
+      } else {
+        index -= left + 1;
+        node = node->right;
+      }
+    }
+
+    return nullptr;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::lower_bound(
+    const K& key
+  ) -> iterator {
+    Node* const node = lower_bound_node(key);
+
+    return node ? iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::lower_bound(
+    const K& key
+  ) const -> const_iterator {
+    Node* const node = lower_bound_node(key);
+
+    return node ? const_iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::lower_bound(
+    const Key& key
+  ) -> iterator {
+    Node* const node = lower_bound_node(key);
+
+    return node ? iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::lower_bound(
+    const Key& key
+  ) const -> const_iterator {
+    Node* const node = lower_bound_node(key);
+
+    return node ? const_iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::upper_bound(
+    const K& key
+  ) -> iterator {
+    Node* const node = upper_bound_node(key);
+
+    return node ? iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::upper_bound(
+    const Key& key
+  ) -> iterator {
+    Node* const node = upper_bound_node(key);
+
+    return node ? iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::equal_range(
+    const K& key
+  ) -> std::pair<iterator, iterator> {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::equal_range(
+    const Key& key
+  ) -> std::pair<iterator, iterator> {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::range(
+    const K& lo,
+    const K& hi
+  ) -> Range<iterator> {
+    const iterator first = lower_bound(lo);
+
+    // an inverted window is empty rather than running off to the end
+    if (comp(hi, lo)) {
+      return {first, first};
+    }
+
+    return {first, lower_bound(hi)};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::upper_bound(
+    const K& key
+  ) const -> const_iterator {
+    Node* const node = upper_bound_node(key);
+
+    return node ? const_iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::upper_bound(
+    const Key& key
+  ) const -> const_iterator {
+    Node* const node = upper_bound_node(key);
+
+    return node ? const_iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::equal_range(
+    const K& key
+  ) const -> std::pair<const_iterator, const_iterator> {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::equal_range(
+    const Key& key
+  ) const -> std::pair<const_iterator, const_iterator> {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::range(
+    const K& lo,
+    const K& hi
+  ) const -> Range<const_iterator> {
+    const const_iterator first = lower_bound(lo);
+
+    // an inverted window is empty rather than running off to the end
+    if (comp(hi, lo)) {
+      return {first, first};
+    }
+
+    return {first, lower_bound(hi)};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename It>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::Range<It>::Range(
+    It first,
+    It last
+  ):
+      first{first}, last{last} {}
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename It>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Range<It>::begin() const
+    -> It {
+    return first;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename It>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::Range<It>::end() const
+    -> It {
+    return last;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::erase(const K& key)
+    -> usize {
+    Node* const node = find_node(key);
+
+    if (node == nullptr) {
+      return 0;
+    }
+
+    erase(iterator{node});
+    return 1;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::erase(const Key& key)
+    -> usize {
+    Node* const node = find_node(key);
+
+    if (node == nullptr) {
+      return 0;
+    }
+
+    erase(iterator{node});
+    return 1;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::erase(iterator it)
+    -> void {
+    if (it == end()) {
+      return;
+    }
+
+    count--;
+
+    Node* const to_erase = it.node;
+
+    // the neighbours of an end are found before its links are gone
+    // the header stands in for a missing neighbour, so erasing the last
+    // node leaves it pointing at itself
+    if (to_erase == header.left) {
+      header.left = to_erase->successor();
+    }
+
+    if (to_erase == header.right) {
+      header.right = to_erase->decrement();
+    }
+
+    const Splice spliced = splice(to_erase);
+    destroy_node(to_erase);
+
+    rebalance(spliced.parent);
+
+    if constexpr (std::is_same_v<Balance, RedBlack>) {
+      if (spliced.removed == black) {
+        fix_red_erase(spliced.child, spliced.parent);
+      }
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::begin() const
+    -> const_iterator {
+    return const_iterator{header.left};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::end() const
+    -> const_iterator {
+    // iterators share the node type, a const_iterator never writes through
+    return const_iterator{const_cast<Node*>(&header)};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rbegin() const
+    -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rend() const
+    -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::front() const
+    -> const Node& {
+    return *header.left;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::back() const
+    -> const Node& {
+    return *header.right;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find(
+    const K& key
+  ) const -> const_iterator {
+    Node* const node = find_node(key);
+
+    return node ? const_iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename Key, typename C, typename>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::find(
+    const Key& key
+  ) const -> const_iterator {
+    Node* const node = find_node(key);
+
+    return node ? const_iterator{node} : end();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::transplant(
+    Node* node,
+    Node* with
+  ) -> void {
+    Node* const parent = node->parent;
+
+    if (parent == &header) {
+      root = with;
+    } else if (parent->left == node) {
+      parent->left = with;
+    } else {
+      parent->right = with;
+    }
+
+    if (with) {
+      with->parent = parent;
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rotate_left(
+    Node* node
+  ) -> Node* {
+    Node* const pivot = node->right;
+
+    node->right = pivot->left;
+    if (pivot->left) {
+      pivot->left->parent = node;
+    }
+
+    transplant(node, pivot);
+    pivot->left = node;
+    node->parent = pivot;
+
+    node->refresh();
+    pivot->refresh();
+    stats.rotations++;
+
+    return pivot;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rotate_right(
+    Node* node
+  ) -> Node* {
+    Node* const pivot = node->left;
+
+    node->left = pivot->right;
+    if (pivot->right) {
+      pivot->right->parent = node;
+    }
+
+    transplant(node, pivot);
+    pivot->right = node;
+    node->parent = pivot;
+
+    node->refresh();
+    pivot->refresh();
+    stats.rotations++;
+
+    return pivot;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::splay(Node* node)
+    -> void {
+    while (node->parent != &header) {
+      Node* const parent = node->parent;
+      Node* const grand = parent->parent;
+      const bool on_left = node == parent->left;
+
+      if (grand == &header) {
+        // zig, one level short of the root
+        on_left ? rotate_right(parent) : rotate_left(parent);
+      } else if (on_left == (parent == grand->left)) {
+        // zig-zig, the grandparent goes down first
+        on_left ? rotate_right(grand) : rotate_left(grand);
+        on_left ? rotate_right(parent) : rotate_left(parent);
+      } else {
+        // zig-zag, up past the parent and then past the grandparent
+        on_left ? rotate_right(parent) : rotate_left(parent);
+        on_left ? rotate_left(grand) : rotate_right(grand);
+      }
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::splice(Node* node)
+    -> Splice {
+    Splice spliced{node->parent, nullptr, node->balance};
+
+    if (node->left == nullptr) {
+      spliced.child = node->right;
+      transplant(node, node->right);
+    } else if (node->right == nullptr) {
+      spliced.child = node->left;
+      transplant(node, node->left);
+    } else {
+      // the successor leaves its own position and takes over this one
+      Node* const successor = node->right->first();
+
+      spliced.parent = successor;
+      spliced.child = successor->right;
+      spliced.removed = successor->balance;
+
+      if (successor->parent != node) {
+        spliced.parent = successor->parent;
+        transplant(successor, successor->right);
+        successor->right = node->right;
+        successor->right->parent = successor;
+      }
+
+      transplant(node, successor);
+      successor->left = node->left;
+      successor->left->parent = successor;
+      successor->height = node->height;
+      successor->balance = node->balance;
+    }
+
+    node->parent = nullptr;
+    node->left = nullptr;
+    node->right = nullptr;
+
+    return spliced;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::rebalance(Node* node)
+    -> void {
+    if constexpr (not std::is_same_v<Balance, AVL>) {
+      stats.height_updates += node->recalc_height();
+      return;
+    }
+
+    while (not node->is_header()) {
+      const usize before = node->height;
+
+      node->refresh();
+      stats.height_updates++;
+
+      if (node->balance > 1) {
+        // right heavy, right-left case needs the child turned first
+        if (node->right->balance < 0) {
+          rotate_right(node->right);
+        }
+        node = rotate_left(node);
+      } else if (node->balance < -1) {
+        // left heavy, left-right case needs the child turned first
+        if (node->left->balance > 0) {
+          rotate_left(node->left);
+        }
+        node = rotate_right(node);
+      }
+
+      // the subtree is as tall as before, nothing above can be out of balance
+      // (but the aggregates above still have to be brought up to date)
+      if (node->height == before and not augmented) {
+        break;
+      }
+
+      node = node->parent;
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::refresh_above(
+    Node* node
+  ) -> void {
+    rebalance(node->parent);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::is_red(
+    const Node* node
+  ) -> bool {
+    return node and node->balance == red;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::fix_red_insert(
+    Node* node
+  ) -> void {
+    // a red node with a red parent, the parent is never the root so the
+    // grandparent exists
+    while (node != root and is_red(node->parent)) {
+      Node* parent = node->parent;
+      Node* const grandparent = parent->parent;
+
+      if (parent == grandparent->left) {
+        Node* const uncle = grandparent->right;
+
+        if (is_red(uncle)) {
+          parent->balance = black;
+          uncle->balance = black;
+          grandparent->balance = red;
+          node = grandparent;
+          continue;
+        }
+
+        if (node == parent->right) {
+          refresh_above(rotate_left(parent));
+          parent = node;
+        }
+
+        parent->balance = black;
+        grandparent->balance = red;
+        refresh_above(rotate_right(grandparent));
+        break;
+      } else {
+        Node* const uncle = grandparent->left;
+
+        if (is_red(uncle)) {
+          parent->balance = black;
+          uncle->balance = black;
+          grandparent->balance = red;
+          node = grandparent;
+          continue;
+        }
+
+        if (node == parent->left) {
+          refresh_above(rotate_right(parent));
+          parent = node;
+        }
+
+        parent->balance = black;
+        grandparent->balance = red;
+        refresh_above(rotate_left(grandparent));
+        break;
+      }
+    }
+
+    root->balance = black;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::fix_red_erase(
+    Node* node,
+    Node* parent
+  ) -> void {
+    // 'node' carries an extra black, push it up until it lands on a red node
+    // or can be removed with rotations
+    while (node != root and not is_red(node)) {
+      if (node == parent->left) {
+        Node* sibling = parent->right;
+
+        if (is_red(sibling)) {
+          sibling->balance = black;
+          parent->balance = red;
+          refresh_above(rotate_left(parent));
+          sibling = parent->right;
+        }
+
+        if (not is_red(sibling->left) and not is_red(sibling->right)) {
+          sibling->balance = red;
+          node = parent;
+          parent = node->parent;
+          continue;
+        }
+
+        if (not is_red(sibling->right)) {
+          sibling->left->balance = black;
+          sibling->balance = red;
+          refresh_above(rotate_right(sibling));
+          sibling = parent->right;
+        }
+
+        sibling->balance = parent->balance;
+        parent->balance = black;
+        sibling->right->balance = black;
+        refresh_above(rotate_left(parent));
+      } else {
+        Node* sibling = parent->left;
+
+        if (is_red(sibling)) {
+          sibling->balance = black;
+          parent->balance = red;
+          refresh_above(rotate_right(parent));
+          sibling = parent->left;
+        }
+
+        if (not is_red(sibling->left) and not is_red(sibling->right)) {
+          sibling->balance = red;
+          node = parent;
+          parent = node->parent;
+          continue;
+        }
+
+        if (not is_red(sibling->left)) {
+          sibling->right->balance = black;
+          sibling->balance = red;
+          refresh_above(rotate_left(sibling));
+          sibling = parent->left;
+        }
+
+        sibling->balance = parent->balance;
+        parent->balance = black;
+        sibling->left->balance = black;
+        refresh_above(rotate_right(parent));
+      }
+
+      node = root;
+    }
+
+    if (node) {
+      node->balance = black;
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::sanityCheck()
+    -> bool {
+    if (root == nullptr) {
+      return count == 0 and header.left == &header and header.right == &header;
+    }
+
+    if (root->parent != &header or header.parent != &header) {
+      return false;
+    }
+
+    if (header.left != root->first() or header.right != root->last()) {
+      return false;
+    }
+
+    if (std::is_same_v<Balance, RedBlack> and is_red(root)) {
+      return false;
+    }
+
+    usize visited = 0;
+    usize black_height = 0;
+
+    for (Node* node = root->first(); node != &header;) {
+      visited++;
+
+      if (node->left and node->left->parent != node) {
+        return false;
+      }
+
+      if (node->right and node->right->parent != node) {
+        return false;
+      }
+
+      const usize left_height = node->left ? node->left->height + 1 : 0;
+      const usize right_height = node->right ? node->right->height + 1 : 0;
+
+      if (node->height != std::max(left_height, right_height)) {
+        return false;
+      }
+
+      const i32 balance =
+        static_cast<i32>(right_height) - static_cast<i32>(left_height);
+
+      if constexpr (std::is_same_v<Balance, RedBlack>) {
+        if (is_red(node) and (is_red(node->left) or is_red(node->right))) {
+          return false;
+        }
+
+        // every path down to a nullptr leaf passes as many black nodes
+        if (node->left == nullptr or node->right == nullptr) {
+          usize blacks = 0;
+          for (const Node* it = node; it != &header; it = it->parent) {
+            blacks += is_red(it) ? 0 : 1;
+          }
+
+          if (black_height == 0) {
+            black_height = blacks;
+          } else if (blacks != black_height) {
+            return false;
+          }
+        }
+      } else if (node->balance != balance) {
+        return false;
+      }
+
+      if (std::is_same_v<Balance, AVL> and (balance < -1 or balance > 1)) {
+        return false;
+      }
+
+      using aggregate_type = typename Augment::value_type;
+
+      if constexpr (augmented and has_equal<aggregate_type>::value) {
+        const Augment augment{};
+
+        aggregate_type expected = leaf_aggregate(node->key, node->value);
+        if (node->left) {
+          expected = augment.combine(node->left->aggregate, expected);
+        }
+        if (node->right) {
+          expected = augment.combine(expected, node->right->aggregate);
+        }
+
+        if (not(node->aggregate == expected)) {
+          return false;
+        }
+      }
+
+      Node* const next = node->successor();
+      if (next != &header and not comp(node->key, next->key)) {
+        return false;
+      }
+
+      node = next;
+    }
+
+    return visited == count;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::BSTmap(const BSTmap& rhs):
+      comp{rhs.comp},
+      alloc{
+        node_traits::select_on_container_copy_construction(rhs.alloc),
+      },
+      header{typename Node::HeaderTag{}},
+      root{nullptr},
+      count{0} {
+    reserve_nodes(rhs.count);
+    root = clone(rhs.root);
+    reset_header();
+    count = rhs.count;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::BSTmap(BSTmap&& from):
+      comp{from.comp},
+      alloc{from.alloc},
+      header{typename Node::HeaderTag{}},
+      root{std::exchange(from.root, nullptr)},
+      count{std::exchange(from.count, 0)} {
+    reset_header();
+    from.reset_header();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  BSTmap<K, V, Balance, Compare, Allocator, Augment>::~BSTmap() {
+    clear();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename... Args>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::create_node(
+    Args&&... args
+  ) -> Node* {
+    Node* const node = node_traits::allocate(alloc, 1);
+
+    try {
+      node_traits::construct(alloc, node, std::forward<Args>(args)...);
+    } catch (...) {
+      node_traits::deallocate(alloc, node, 1);
+      throw;
+    }
+
+    return node;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::destroy_node(
+    Node* node
+  ) -> void {
+    node_traits::destroy(alloc, node);
+    node_traits::deallocate(alloc, node, 1);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::destroy(Node* node)
+    -> void {
+    // rotate left children up until the top has none, then free it and carry
+    // on with its right subtree. No recursion and no stack, every rotation
+    // moves one node off the left spine for good
+    while (node) {
+      Node* const left = node->left;
+
+      if (left) {
+        node->left = left->right;
+        left->right = node;
+        node = left;
+        continue;
+      }
+
+      Node* const right = node->right;
+      destroy_node(node);
+      node = right;
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::clear() -> void {
+    destroy(root);
+    root = nullptr;
+    reset_header();
+    count = 0;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  template<typename InputIt>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::assign(
+    InputIt first,
+    InputIt last
+  ) -> void {
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+
+    clear();
+
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+      reserve_nodes(static_cast<usize>(std::distance(first, last)));
+    }
+
+    // the sorted run becomes a list through the right pointers first, so the
+    // nodes are allocated in key order without knowing how many there are
+    Node* list = nullptr;
+    Node* tail = nullptr;
+    usize n = 0;
+
+    try {
+      for (; first != last; ++first) {
+        const auto& [key, value] = *first;
+
+        if (tail and not comp(tail->key, key)) {
+          break;
+        }
+
+        Node* const node =
+          create_node(key, value, nullptr, 0, black, nullptr, nullptr);
+        (tail ? tail->right : list) = node;
+        tail = node;
+        n++;
+      }
+    } catch (...) {
+      destroy(list);
+      throw;
+    }
+
+    adopt(list, n);
+
+    for (; first != last; ++first) {
+      const auto& [key, value] = *first;
+      try_emplace_node(key, value);
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::merge(
+    BSTmap& other
+  ) -> void {
+    if (&other == this or other.root == nullptr) {
+      return;
+    }
+
+    if (alloc != other.alloc) {
+      merge_values(other);
+      return;
+    }
+
+    // the other nodes come out in key order, so linking them in one by one
+    // stays in the cache and beats a rebuild until both maps are about as big
+    if (other.count < count) {
+      merge_nodes(other);
+      return;
+    }
+
+    Node* mine = release();
+    Node* theirs = other.release();
+
+    Node* merged = nullptr;
+    Node** merged_end = &merged;
+    usize merged_count = 0;
+
+    Node* kept = nullptr;
+    Node** kept_end = &kept;
+    usize kept_count = 0;
+
+    // both lists are sorted, take the smaller head each time
+    while (mine or theirs) {
+      Node* next = nullptr;
+
+      if (theirs == nullptr or (mine and comp(mine->key, theirs->key))) {
+        next = mine;
+        mine = mine->right;
+      } else if (mine == nullptr or comp(theirs->key, mine->key)) {
+        next = theirs;
+        theirs = theirs->right;
+      } else {
+        // same key on both sides, the other map keeps its node
+        next = mine;
+        mine = mine->right;
+
+        *kept_end = theirs;
+        kept_end = &theirs->right;
+        theirs = theirs->right;
+        kept_count++;
+      }
+
+      *merged_end = next;
+      merged_end = &next->right;
+      merged_count++;
+    }
+
+    *merged_end = nullptr;
+    *kept_end = nullptr;
+
+    adopt(merged, merged_count);
+    other.adopt(kept, kept_count);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::merge(
+    BSTmap&& other
+  ) -> void {
+    merge(other);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::split(
+    const K& key
+  ) -> std::pair<BSTmap, BSTmap> {
+    std::pair<BSTmap, BSTmap> parts{
+      BSTmap{comp, Allocator{alloc}},
+      BSTmap{comp, Allocator{alloc}},
+    };
+
+    Node* const lower = release();
+    Node* upper = lower;
+    Node** lower_end = nullptr;
+    usize lower_count = 0;
+    usize upper_count = 0;
+
+    while (upper and comp(upper->key, key)) {
+      lower_end = &upper->right;
+      upper = upper->right;
+      lower_count++;
+    }
+
+    if (lower_end) {
+      *lower_end = nullptr;
+    }
+
+    for (const Node* node = upper; node; node = node->right) {
+      upper_count++;
+    }
+
+    parts.first.adopt(lower_count ? lower : nullptr, lower_count);
+    parts.second.adopt(upper, upper_count);
+
+    return parts;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::join(
+    BSTmap&& left,
+    BSTmap&& right
+  ) -> BSTmap {
+    BSTmap joined{std::move(left)};
+    Node* const last = joined.root ? joined.header.right : nullptr;
+    const Node* const first = right.root ? right.header.left : nullptr;
+
+    const bool overlap =
+      last and first and not joined.comp(last->key, first->key);
+
+    if (overlap or joined.alloc != right.alloc) {
+      joined.merge(right);
+      return joined;
+    }
+
+    const usize n = joined.count + right.count;
+    Node* list = joined.release();
+
+    // the greatest node on the left ends the list, the right one goes on
+    if (last) {
+      last->right = right.release();
+    } else {
+      list = right.release();
+    }
+
+    joined.adopt(list, n);
+
+    return joined;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::adopt(
+    Node* list,
+    usize n
+  ) -> void {
+    // every subtree splits its nodes in half, so the deepest nodes are
+    // log2(n) down
+    usize bottom = 0;
+    for (usize size = n; size > 1; size /= 2) {
+      bottom++;
+    }
+
+    root = build(list, n, 0, bottom);
+    count = n;
+    reset_header();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::release() -> Node* {
+    Node* list = nullptr;
+    Node** end = &list;
+
+    // same rotations as destroy, but every node with no left child left is
+    // appended to the list instead of freed
+    for (Node* node = root; node;) {
+      Node* const left = node->left;
+
+      if (left) {
+        node->left = left->right;
+        left->right = node;
+        node = left;
+        continue;
+      }
+
+      *end = node;
+      end = &node->right;
+      node = node->right;
+    }
+
+    root = nullptr;
+    count = 0;
+    reset_header();
+
+    return list;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::merge_nodes(
+    BSTmap& other
+  ) -> void {
+    Node* list = other.release();
+    Node* kept = nullptr;
+    Node** kept_end = &kept;
+    usize kept_count = 0;
+
+    while (list) {
+      Node* const node = list;
+      list = list->right;
+
+      const Descent descent = index(node->key);
+
+      if (is_match(descent.bound, node->key)) {
+        *kept_end = node;
+        kept_end = &node->right;
+        kept_count++;
+        continue;
+      }
+
+      // back to a bare leaf, then linked in as if it was just built
+      node->left = nullptr;
+      node->right = nullptr;
+      node->refresh();
+      attach(node, descent.parent, descent.bound == descent.parent);
+    }
+
+    *kept_end = nullptr;
+    other.adopt(kept, kept_count);
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::merge_values(
+    BSTmap& other
+  ) -> void {
+    for (auto it = other.begin(); it != other.end();) {
+      const auto [node, inserted] =
+        try_emplace_node(std::move(it->key), std::move(it->value));
+
+      if (inserted) {
+        other.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::build(
+    Node*& list,
+    usize n,
+    usize depth,
+    usize bottom
+  ) -> Node* {
+    // recursion is only log2(n) deep here, the halves differ by at most one
+    if (n == 0) {
+      return nullptr;
+    }
+
+    Node* const left = build(list, n / 2, depth + 1, bottom);
+    Node* const node = list;
+    list = list->right;
+
+    node->left = left;
+    if (left) {
+      left->parent = node;
+    }
+
+    node->right = build(list, n - n / 2 - 1, depth + 1, bottom);
+    if (node->right) {
+      node->right->parent = node;
+    }
+
+    node->refresh();
+
+    // a red bottom row evens out the black height when it is not full
+    if constexpr (std::is_same_v<Balance, RedBlack>) {
+      node->balance = depth == bottom and depth > 0 ? red : black;
+    }
+
+    return node;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::reset_header()
+    -> void {
+    if (root == nullptr) {
+      header.left = &header;
+      header.right = &header;
+      return;
+    }
+
+    root->parent = &header;
+    header.left = root->first();
+    header.right = root->last();
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::clone(
+    const Node* source
+  ) -> Node* {
+    if (source == nullptr) {
+      return nullptr;
+    }
+
+    Node* const copy = create_node(
+      source->key,
+      source->value,
+      nullptr,
+      source->height,
+      source->balance,
+      nullptr,
+      nullptr
+    );
+
+    try {
+      // walk both trees in step, going down into whichever child still has
+      // to be copied and climbing the parent links when both are done
+      const Node* from = source;
+      Node* to = copy;
+
+      while (true) {
+        if (from->left and not to->left) {
+          from = from->left;
+          to->left = create_node(
+            from->key,
+            from->value,
+            to,
+            from->height,
+            from->balance,
+            nullptr,
+            nullptr
+          );
+          to = to->left;
+        } else if (from->right and not to->right) {
+          from = from->right;
+          to->right = create_node(
+            from->key,
+            from->value,
+            to,
+            from->height,
+            from->balance,
+            nullptr,
+            nullptr
+          );
+          to = to->right;
+        } else {
+          // both subtrees are done, what they add up to carries over as is
+          to->aggregate = from->aggregate;
+
+          if (from == source) {
+            break;
+          }
+
+          from = from->parent;
+          to = to->parent;
+        }
+      }
+    } catch (...) {
+      destroy(copy);
+      throw;
+    }
+
+    return copy;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::reserve_nodes(
+    usize n
+  ) -> void {
+    if constexpr (has_reserve<node_allocator>::value) {
+      alloc.reserve(n);
+    }
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::begin() -> iterator {
+    return iterator{header.left};
+  }
+
+  ////////////////////////////////////////////////////////////
+  // do not change this code from here to the end of the file
+  /* figure out whether node is left or right child or root
+   * used in print_backwards_padded
+   */
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::getedgesymbol(
+    const Node* node
+  ) const -> char {
+    const Node* parent = node->parent;
+
+    if (parent == &header) {
+      return '-';
+    }
+
+    return parent->left == node ? '\\' : '/';
+  }
+
+  /* this is another "ASCII-graphical" print, but using
+   * iterative function.
+   * Left branch of the tree is at the bottom
+   */
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto operator<<(
+    std::ostream& os,
+    const BSTmap<K, V, Balance, Compare, Allocator, Augment>& map
+  ) -> std::ostream& {
+    map.print(os);
+    return os;
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::print(
+    std::ostream& os,
+    bool print_value
+  ) const -> void {
+    if (root) {
+      Node* b = header.right;
+      while (b != &header) {
+        int depth = getdepth(*b);
+        int i;
+        /* printf(b); */
+
+        char edge = getedgesymbol(b);
+        switch (edge) {
+          case '-':
+            for (i = 0; i < depth; ++i) {
+              std::printf("       ");
+            }
+            os << b->key;
+            if (print_value) {
+              os << " -> " << b->value;
+            }
+            os << std::endl;
+            break;
+          case '\\':
+            for (i = 0; i < depth; ++i) {
+              std::printf("       ");
+            }
+            os << edge << std::endl;
+            for (i = 0; i < depth; ++i) {
+              std::printf("       ");
+            }
+            os << b->key;
+            if (print_value) {
+              os << " -> " << b->value;
+            }
+            os << std::endl;
+            break;
+          case '/':
+            for (i = 0; i < depth; ++i) {
+              std::printf("       ");
+            }
+            os << b->key;
+            if (print_value) {
+              os << " -> " << b->value;
+            }
+            os << std::endl;
+            for (i = 0; i < depth; ++i) {
+              std::printf("       ");
+            }
+            os << edge << std::endl;
+            break;
+        }
+        b = b->decrement();
+      }
+    }
+    std::printf("\n");
+  }
+
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto BSTmap<K, V, Balance, Compare, Allocator, Augment>::getdepth(
+    const Node& node
+  ) const -> usize {
+    usize depth = 0;
+
+    for (const Node* it = node.parent; it != &header; it = it->parent) {
+      depth++;
+    }
+
+    return depth;
   }
 } // namespace CS280
 
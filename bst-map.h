@@ -1,90 +1,148 @@
 #ifndef BSTMAP_H
 #define BSTMAP_H
 
-/**
- * @brief 32 Bit Floating Point Number
- */
-#include <cstdint>
-using f32 = float;
-
-/**
- * @brief 64 Bit Floating Point Number
- */
-using f64 = long double;
-
-/**
- * @brief Fix Sized Unsigned 8 Bit Integer (cannot be negative)
- */
-using u8 = std::uint8_t;
-
-/**
- * @brief Fix Sized Unsigned 16 Bit Integer (cannot be negative)
- */
-using u16 = std::uint16_t;
-
-/**
- * @brief Fix Sized Unsigned 32 Bit Integer (cannot be negative)
- */
-using u32 = std::uint32_t;
-
-/**
- * @brief Fix Sized Unsigned 64 Bit Integer (cannot be negative)
- */
-using u64 = unsigned long int;
-
-/**
- * @brief Biggest Unsigned Integer type that the current platform can use
- * (cannot be negative)
- */
-using umax = std::uintmax_t;
-
-/**
- * @brief Unsigned Integer for when referring to any form of memory size or
- * offset (eg. an array length or index)
- */
-using usize = std::size_t;
-/**
- * @brief Unsigned Integer Pointer typically used for pointer arithmetic
- */
-using uptr = std::uintptr_t;
-
-/**
- * @brief Signed 8 bit Integer
- */
-using i8 = std::int8_t;
-
-/**
- * @brief Signed 16 bit Integer
- */
-using i16 = std::int16_t;
-
-/**
- * @brief Signed 32 bit Integer
- */
-using i32 = std::int32_t;
-
-/**
- * @brief Signed 64 bit Integer
- */
-using i64 = std::int64_t;
-
-/**
- * @brief Integer pointer typically used for pointer arithmetic
- */
-using iptr = std::intptr_t;
+#include "types.h"
+#include "eytzinger-bst-map.h"
+#include "frozen-bst-map.h"
+#include "pool-allocator.h"
 
 #include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace CS280 {
 
+  /**
+   * @brief Does the allocator offer reserve(n) to set up room for n objects in
+   * one go (like PoolAllocator)
+   */
+  template<typename A, typename = void>
+  struct has_reserve : std::false_type {};
+
+  template<typename A>
+  struct has_reserve<
+    A,
+    std::void_t<decltype(std::declval<A&>().reserve(usize{}))>> :
+      std::true_type {};
+
+  /**
+   * @brief Does the Augment policy build the aggregate of a node from its key
+   * alone (leaf(key)), so values can be written without touching it
+   */
+  template<typename A, typename K, typename = void>
+  struct has_key_leaf : std::false_type {};
+
+  template<typename A, typename K>
+  struct has_key_leaf<
+    A,
+    K,
+    std::void_t<
+      decltype(std::declval<const A&>().leaf(std::declval<const K&>()))>> :
+      std::true_type {};
+
+  /**
+   * @brief Can two values of the type be compared with ==
+   */
+  template<typename T, typename = void>
+  struct has_equal : std::false_type {};
+
+  template<typename T>
+  struct has_equal<
+    T,
+    std::void_t<
+      decltype(std::declval<const T&>() == std::declval<const T&>())>> :
+      std::true_type {};
+
+  /**
+   * @brief Balancing policy for a plain binary search tree, nodes are placed
+   * where the search ends and are never rotated
+   */
+  struct Unbalanced {};
+
+  /**
+   * @brief Balancing policy for an AVL tree, after every insert and erase the
+   * heights of the two subtrees of any node differ by at most one
+   */
+  struct AVL {};
+
+  /**
+   * @brief Balancing policy for a red-black tree, looser than AVL but an
+   * insert or erase does at most three rotations
+   */
+  struct RedBlack {};
+
+  /**
+   * @brief Balancing policy for a splay tree, nothing is kept in balance but
+   * every insert and every non-const find rotates the node it reaches up to
+   * the root, so the keys asked for most stay a few levels down
+   */
+  struct Splay {};
+
+  /**
+   * @brief Augmentation policy that keeps nothing extra in the nodes
+   */
+  struct NoAugment {
+    /**
+     * @brief Nothing is stored, the member takes up spare padding only
+     */
+    struct value_type {};
+  };
+
+  /**
+   * @brief Augmentation policy that keeps the size of every subtree in its
+   * root, which lets rank and select run in O(log n)
+   */
+  struct SubtreeSize {
+    using value_type = usize;
+
+    /**
+     * @brief Size of an empty window
+     */
+    auto identity() const -> usize;
+
+    /**
+     * @brief A single node counts as one
+     */
+    template<typename K>
+    auto leaf(const K& key) const -> usize;
+
+    /**
+     * @brief Sizes of neighbouring subtrees add up
+     */
+    auto combine(usize lhs, usize rhs) const -> usize;
+  };
+
   /**
    * @brief Binary Search Tree
    *
    * @tparam K Key
    * @tparam V Value
+   * @tparam Balance Balancing policy (Unbalanced, AVL, RedBlack or Splay)
+   * @tparam Compare Strict weak ordering on keys, a transparent comparator
+   * (one with an is_transparent member, like std::less<>) also enables
+   * lookups by any type it can compare against K
+   * @tparam Allocator Allocator for the key / value pairs, rebound to
+   * allocate whole nodes (std::allocator or PoolAllocator)
+   * @tparam Augment What every node keeps about its subtree, recomputed along
+   * with the heights. NoAugment, SubtreeSize or any stateless monoid with a
+   * value_type, identity(), leaf(key) or leaf(key, value) for a single node
+   * and an associative combine(lhs, rhs) for neighbouring subtrees in key
+   * order. With leaf(key, value) values are read only in place (operator[]
+   * does not compile and Value() is const), they change by insert_or_assign,
+   * which refreshes the aggregates above
    */
-  template<typename K, typename V>
+  template<
+    typename K,
+    typename V,
+    typename Balance = Unbalanced,
+    typename Compare = std::less<K>,
+    typename Allocator = std::allocator<std::pair<const K, V>>,
+    typename Augment = NoAugment>
   class BSTmap {
 
   public:
@@ -92,6 +150,15 @@ namespace CS280 {
     class iterator;
     class const_iterator;
 
+    /**
+     * @brief What Node::Value() hands out, a const reference when the Augment
+     * policy builds aggregates from values, so none go stale behind its back
+     */
+    using value_reference = std::conditional_t<
+      std::is_same_v<Augment, NoAugment> or has_key_leaf<Augment, K>::value,
+      V&,
+      const V&>;
+
     /**
      * @class Node
      * @brief BST Node
@@ -102,7 +169,22 @@ namespace CS280 {
       /**
        * @brief Normal constructor
        */
-      Node(K k, V val, Node* p, usize h, i32 b, Node* l, Node* r);
+      Node(
+        const K& k,
+        const V& val,
+        Node* p,
+        usize h,
+        i32 b,
+        Node* l,
+        Node* r
+      );
+
+      /**
+       * @brief Leaf constructor, the key is built from 'k' and the value in
+       * place from 'args'
+       */
+      template<typename KeyArg, typename... Args>
+      Node(std::in_place_t, Node* p, KeyArg&& k, Args&&... args);
 
       /**
        * @brief Copy constructor
@@ -110,7 +192,7 @@ namespace CS280 {
       Node(const Node&) = delete;
 
       /**
-       * @brief Destructor
+       * @brief Destructor, the children are freed by the BSTmap
        */
       ~Node();
 
@@ -127,7 +209,7 @@ namespace CS280 {
       /**
        * @brief Gets the value stored
        */
-      auto Value() -> V&; // return a reference
+      auto Value() -> value_reference; // return a reference
 
       /**
        * @brief Gets the leftmost node
@@ -141,12 +223,13 @@ namespace CS280 {
       auto last() -> Node*; // maximum - follow right as far as possible
 
       /**
-       * @brief Gets the successor node
+       * @brief Gets the successor node, the header after the last one
        */
       auto successor() -> Node*; // successor
 
       /**
-       * @brief Gets the predecessor Node
+       * @brief Gets the predecessor Node, the header before the first one
+       * (and the last node before the header)
        */
       auto decrement() -> Node*; // predecessor
 
@@ -158,29 +241,58 @@ namespace CS280 {
     private:
 
       /**
-       * @brief Clones a new node on the heap
+       * @brief Tag for the header constructor
+       */
+      struct HeaderTag {};
+
+      /**
+       * @brief Height that marks the header, no real node gets near it
+       */
+      static constexpr usize header_height = static_cast<usize>(-1);
+
+      /**
+       * @brief Header constructor, the key and value are never built
        */
-      auto clone() const -> Node*;
+      explicit Node(HeaderTag);
 
       /**
-       * @brief Creates & adds a child with the given key and value
+       * @brief Is this the header of a map rather than an element
        */
-      auto add_child(K key, V value) -> Node&;
+      [[nodiscard]] auto is_header() const -> bool;
 
       /**
-       * @brief Recomputes the height (recurses up)
+       * @brief Links the given node as the left or right child
        */
-      auto recalc_height() -> void;
+      auto add_child(Node* node, bool on_left) -> Node&;
 
       /**
-       * @brief Key data
+       * @brief Recomputes the height and balance, moving up to the parent only
+       * while the height keeps changing (all the way up when augmented).
+       * Returns how many nodes it refreshed
        */
-      K key;
+      auto recalc_height() -> usize;
 
       /**
-       * @brief Value data
+       * @brief Recomputes the height, balance and aggregate from the children
+       * only, the color of a red-black node is left alone
        */
-      V value;
+      auto refresh() -> void;
+
+      // the header leaves both unions empty, every other node holds a key
+      // and a value
+      union {
+        /**
+         * @brief Key data
+         */
+        K key;
+      };
+
+      union {
+        /**
+         * @brief Value data
+         */
+        V value;
+      };
 
       /**
        * @brief Pointer to the parent
@@ -193,10 +305,16 @@ namespace CS280 {
       usize height;
 
       /**
-       * @brief Balance of the node
+       * @brief Balance of the node, height of the right subtree minus height
+       * of the left subtree (the color for RedBlack, see red / black)
        */
       i32 balance;
 
+      /**
+       * @brief What the Augment policy keeps about this subtree
+       */
+      typename Augment::value_type aggregate;
+
       /**
        * @brief Left child
        */
@@ -212,12 +330,18 @@ namespace CS280 {
 
     /**
      * @class iterator
-     * @brief Iterator for a non-const BST
-     *
+     * @brief Iterator for a non-const BST. Stepping needs an iterator that
+     * came from a map, a default constructed one is singular
      */
     class iterator {
     public:
 
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Node;
+      using difference_type = std::ptrdiff_t;
+      using pointer = Node*;
+      using reference = Node&;
+
       /**
        * @brief Default / normal constructor
        */
@@ -233,6 +357,17 @@ namespace CS280 {
        */
       auto operator++(int) -> iterator;
 
+      /**
+       * @brief Pre-decrement, move to the previous (end to the last)
+       */
+      auto operator--() -> iterator&;
+
+      /**
+       * @brief Post-decrement, returns the current and after move to the
+       * previous
+       */
+      auto operator--(int) -> iterator;
+
       /**
        * @brief Gets the inner node
        */
@@ -262,11 +397,18 @@ namespace CS280 {
 
     /**
      * @class const_iterator
-     * @brief Iterator for a const BST
+     * @brief Iterator for a const BST, like iterator a default constructed
+     * one cannot be stepped
      */
     class const_iterator {
     public:
 
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Node;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Node*;
+      using reference = const Node&;
+
       /**
        * @brief Default/Normal Constructor
        */
@@ -282,6 +424,16 @@ namespace CS280 {
        */
       auto operator++(int) -> const_iterator;
 
+      /**
+       * @brief Pre-decrement
+       */
+      auto operator--() -> const_iterator&;
+
+      /**
+       * @brief Post-decrement
+       */
+      auto operator--(int) -> const_iterator;
+
       /**
        * @brief Gets a refereence to the inner node
        */
@@ -312,21 +464,85 @@ namespace CS280 {
       Node* node;
     };
 
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
     /**
-     * @brief Iterator at the end of every BST
+     * @class Range
+     * @brief Pair of iterators that a range based for can walk, from the
+     * first element of a window up to (not including) the last
+     *
+     * @tparam It iterator or const_iterator
      */
-    static const iterator end_it;
+    template<typename It>
+    class Range {
+    public:
+
+      /**
+       * @brief Normal constructor
+       */
+      Range(It first, It last);
+
+      /**
+       * @brief First element of the window
+       */
+      [[nodiscard]] auto begin() const -> It;
+
+      /**
+       * @brief One past the last element of the window
+       */
+      [[nodiscard]] auto end() const -> It;
+
+    private:
+
+      /**
+       * @brief First element of the window
+       */
+      It first;
+
+      /**
+       * @brief One past the last element of the window
+       */
+      It last;
+    };
 
     /**
-     * @brief Const Iterator at the end of every BST
+     * @brief Counters for the work done keeping the tree in shape
      */
-    static const const_iterator const_end_it;
+    struct Stats {
+      /**
+       * @brief Nodes whose height was recomputed after an insert or erase
+       */
+      usize height_updates{0};
+
+      /**
+       * @brief Single rotations, a double rotation counts as two
+       */
+      usize rotations{0};
+    };
 
     /**
      * @brief Default constructor
      */
     BSTmap();
 
+    /**
+     * @brief Constructs an empty map ordered by the given comparator (for
+     * comparators with state), nodes come from the given allocator
+     */
+    explicit BSTmap(const Compare& comp, const Allocator& alloc = Allocator());
+
+    /**
+     * @brief Builds the map from key / value pairs, see assign
+     */
+    template<typename InputIt>
+    BSTmap(
+      InputIt first,
+      InputIt last,
+      const Compare& comp = Compare(),
+      const Allocator& alloc = Allocator()
+    );
+
     /**
      * @brief Copy constructor
      *
@@ -369,10 +585,132 @@ namespace CS280 {
     auto empty() -> bool;
 
     /**
-     * @brief Value getter and setter, creates key if it does not exist
+     * @brief Erases every node, without recursion
+     */
+    auto clear() -> void;
+
+    /**
+     * @brief Replaces the contents with the key / value pairs in [first,
+     * last). While the keys come in strictly increasing order the nodes are
+     * built in one pass and linked into a perfectly balanced tree in O(n),
+     * anything after the first key out of order is inserted one at a time
+     * (the first of equal keys wins)
+     */
+    template<typename InputIt>
+    auto assign(InputIt first, InputIt last) -> void;
+
+    /**
+     * @brief Moves the nodes of the other map whose keys are not here yet
+     * into this one, without copying or reallocating them (the rest stay in
+     * 'other'). Falls back to moving the keys and values over when the
+     * allocators cannot free each other's nodes
+     */
+    auto merge(BSTmap& other) -> void;
+
+    /**
+     * @brief merge from a map that is about to go away
+     */
+    auto merge(BSTmap&& other) -> void;
+
+    /**
+     * @brief Splits the map into the elements with keys less than the given
+     * key and the rest, in O(n) and without reallocating any node. This map
+     * is left empty
+     */
+    auto split(const K& key) -> std::pair<BSTmap, BSTmap>;
+
+    /**
+     * @brief Puts two maps back together, in O(n) and without reallocating
+     * any node when every key of 'left' is less than every key of 'right'
+     * (otherwise it is a merge, and the keys of 'left' win)
+     */
+    static auto join(BSTmap&& left, BSTmap&& right) -> BSTmap;
+
+    /**
+     * @brief How many levels the tree has (0 when empty)
+     */
+    [[nodiscard]] auto height() const -> usize;
+
+    /**
+     * @brief How many levels below the root the element is (0 for the root),
+     * it must not be end()
+     */
+    [[nodiscard]] auto depth(const_iterator it) const -> usize;
+
+    /**
+     * @brief Work counters since construction or the last reset
+     */
+    [[nodiscard]] auto statistics() const -> const Stats&;
+
+    /**
+     * @brief Zeroes the work counters
+     */
+    auto reset_statistics() -> void;
+
+    /**
+     * @brief Value getter and setter, creates key if it does not exist. Not
+     * for Augment policies that read values, use insert_or_assign
      */
     auto operator[](const K& key) -> V&;
 
+    /**
+     * @brief Value getter and setter, moves the key in if it does not exist
+     */
+    auto operator[](K&& key) -> V&;
+
+    /**
+     * @brief Builds a node from the arguments (the first one makes the key,
+     * the rest make the value) and links it in unless the key is already
+     * there, in which case the node is thrown away
+     */
+    template<typename... Args>
+    auto emplace(Args&&... args) -> std::pair<iterator, bool>;
+
+    /**
+     * @brief Inserts a value built in place from 'args' if the key is not
+     * there yet, otherwise nothing is built or moved from
+     */
+    template<typename... Args>
+    auto try_emplace(const K& key, Args&&... args) -> std::pair<iterator, bool>;
+
+    /**
+     * @brief try_emplace that moves the key in
+     */
+    template<typename... Args>
+    auto try_emplace(K&& key, Args&&... args) -> std::pair<iterator, bool>;
+
+    /**
+     * @brief Assigns to the value if the key is there, otherwise inserts a
+     * value built from 'obj'
+     */
+    template<typename M>
+    auto insert_or_assign(const K& key, M&& obj) -> std::pair<iterator, bool>;
+
+    /**
+     * @brief insert_or_assign that moves the key in
+     */
+    template<typename M>
+    auto insert_or_assign(K&& key, M&& obj) -> std::pair<iterator, bool>;
+
+    /**
+     * @brief Inserts every key / value pair of the range whose key is not
+     * there yet (the first of equal keys wins), returns how many went in.
+     * The batch is sorted, looked up a group at a time like find_batch, and
+     * each insert starts from where the previous one ended, climbing only as
+     * far as the next key needs
+     */
+    template<typename Pairs>
+    auto insert_batch(const Pairs& pairs) -> usize;
+
+    /**
+     * @brief Looks up every key of the container and writes an iterator for
+     * each to 'out' in the same order (end() for the missing ones). The keys
+     * are sorted and searched in groups that share the path down to where
+     * they part ways, then go on side by side a level at a time
+     */
+    template<typename Keys, typename Out>
+    auto find_batch(const Keys& keys, Out out) -> Out;
+
     /**
      * @brief Beginning iterator (mutable)
      */
@@ -383,17 +721,111 @@ namespace CS280 {
      */
     auto end() -> iterator;
 
+    /**
+     * @brief Reverse beginning, at the last element (mutable)
+     */
+    auto rbegin() -> reverse_iterator;
+
+    /**
+     * @brief Reverse end (mutable)
+     */
+    auto rend() -> reverse_iterator;
+
+    /**
+     * @brief Element with the smallest key, the map must not be empty
+     */
+    auto front() -> Node&;
+
+    /**
+     * @brief Element with the greatest key, the map must not be empty
+     */
+    auto back() -> Node&;
+
     /**
      * @brief Attempts to find an iterator pointing to a node in this BST that
-     * has the given key
+     * has the given key, under Splay that node becomes the root
      */
     auto find(const K& key) -> iterator;
 
+    /**
+     * @brief Finds by any key the comparator is transparent to, without
+     * building a K
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto find(const Key& key) -> iterator;
+
+    /**
+     * @brief First element whose key is not less than the given key
+     */
+    auto lower_bound(const K& key) -> iterator;
+
+    /**
+     * @brief Transparent lower_bound
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto lower_bound(const Key& key) -> iterator;
+
+    /**
+     * @brief First element whose key is greater than the given key
+     */
+    auto upper_bound(const K& key) -> iterator;
+
+    /**
+     * @brief Transparent upper_bound
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto upper_bound(const Key& key) -> iterator;
+
+    /**
+     * @brief Elements equivalent to the given key, as lower_bound and
+     * upper_bound
+     */
+    auto equal_range(const K& key) -> std::pair<iterator, iterator>;
+
+    /**
+     * @brief Transparent equal_range
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto equal_range(const Key& key) -> std::pair<iterator, iterator>;
+
+    /**
+     * @brief Elements with keys in [lo, hi), found in O(log n) and then
+     * walked with Node::successor
+     */
+    auto range(const K& lo, const K& hi) -> Range<iterator>;
+
     /**
      * @brief Attempts to erase the node represented by the given iterator
      */
     auto erase(iterator it) -> void;
 
+    /**
+     * @brief Erases the element with the given key, returns how many were
+     * erased (0 or 1)
+     */
+    auto erase(const K& key) -> usize;
+
+    /**
+     * @brief Transparent erase by key
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto erase(const Key& key) -> usize;
+
     /**
      * @brief Beginning iterator (const)
      */
@@ -404,12 +836,148 @@ namespace CS280 {
      */
     auto end() const -> const_iterator;
 
+    /**
+     * @brief Reverse beginning, at the last element (const)
+     */
+    auto rbegin() const -> const_reverse_iterator;
+
+    /**
+     * @brief Reverse end (const)
+     */
+    auto rend() const -> const_reverse_iterator;
+
+    /**
+     * @brief Element with the smallest key (const)
+     */
+    auto front() const -> const Node&;
+
+    /**
+     * @brief Element with the greatest key (const)
+     */
+    auto back() const -> const Node&;
+
     /**
      * @brief Attempts to find an iterator pointing to a node in this BST that
      * has the given key
      */
     auto find(const K& key) const -> const_iterator;
 
+    /**
+     * @brief Transparent find (const)
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto find(const Key& key) const -> const_iterator;
+
+    /**
+     * @brief First element whose key is not less than the given key (const)
+     */
+    auto lower_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Transparent lower_bound (const)
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto lower_bound(const Key& key) const -> const_iterator;
+
+    /**
+     * @brief First element whose key is greater than the given key (const)
+     */
+    auto upper_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Transparent upper_bound (const)
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto upper_bound(const Key& key) const -> const_iterator;
+
+    /**
+     * @brief Elements equivalent to the given key (const)
+     */
+    auto equal_range(const K& key) const
+      -> std::pair<const_iterator, const_iterator>;
+
+    /**
+     * @brief Transparent equal_range (const)
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto equal_range(const Key& key) const
+      -> std::pair<const_iterator, const_iterator>;
+
+    /**
+     * @brief Elements with keys in [lo, hi) (const)
+     */
+    auto range(const K& lo, const K& hi) const -> Range<const_iterator>;
+
+    /**
+     * @brief Combines the Augment values of the elements with keys in
+     * [lo, hi) in key order, in O(log n) from the aggregates of the whole
+     * subtrees inside the window. The identity if the window is empty
+     */
+    auto aggregate(const K& lo, const K& hi) const
+      -> typename Augment::value_type;
+
+    /**
+     * @brief How many elements have keys less than the given key, needs the
+     * SubtreeSize augmentation
+     */
+    auto rank(const K& key) const -> usize;
+
+    /**
+     * @brief Element at the given position in key order (0 is the smallest),
+     * end() if there is no such position. Iterating on from it walks the rest
+     * in order. Needs the SubtreeSize augmentation
+     */
+    auto select(usize index) -> iterator;
+
+    /**
+     * @brief Element at the given position in key order (const)
+     */
+    auto select(usize index) const -> const_iterator;
+
+    /**
+     * @brief Batch find (const)
+     */
+    template<typename Keys, typename Out>
+    auto find_batch(const Keys& keys, Out out) const -> Out;
+
+    /**
+     * @brief Is there an element with the given key
+     */
+    auto contains(const K& key) const -> bool;
+
+    /**
+     * @brief Transparent contains
+     */
+    template<
+      typename Key,
+      typename C = Compare,
+      typename = typename C::is_transparent>
+    auto contains(const Key& key) const -> bool;
+
+    /**
+     * @brief Copies every element into an immutable snapshot whose keys are
+     * laid out for lookups that touch few cache lines
+     */
+    auto freeze() const -> FrozenBSTmap<K, V, Compare>;
+
+    /**
+     * @brief Copies every element into an immutable snapshot in breadth first
+     * order, searched without branches
+     */
+    auto freeze_eytzinger() const -> EytzingerBSTmap<K, V, Compare>;
+
     // do not need this one (why)
     // const_iterator erase(iterator& it) const;
 
@@ -423,6 +991,11 @@ namespace CS280 {
      */
     auto getedgesymbol(const Node* node) const -> char;
 
+    /**
+     * @brief Checks parent links, key ordering, heights, balance factors, the
+     * node count and cached ends, the AVL / red-black invariants for those
+     * policies, and the aggregates when they can be compared with ==
+     */
     auto sanityCheck() -> bool;
 
     friend class iterator;
@@ -430,18 +1003,347 @@ namespace CS280 {
 
   private:
 
+    /**
+     * @brief Allocator rebound to whole nodes
+     */
+    using node_allocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+
+    /**
+     * @brief Traits of the node allocator
+     */
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    /**
+     * @brief Does the Augment policy keep anything, when it does the nodes
+     * above a change are refreshed all the way up to the root
+     */
+    static constexpr bool augmented = not std::is_same_v<Augment, NoAugment>;
+
+    /**
+     * @brief Does the aggregate of a node depend on its value
+     */
+    static constexpr bool value_augmented =
+      augmented and not has_key_leaf<Augment, K>::value;
+
+    /**
+     * @brief How many keys of a batch are looked up side by side
+     */
+    static constexpr usize batch_lanes = 16;
+
+    /**
+     * @brief Color of a red node, stored in Node::balance under RedBlack
+     */
+    static constexpr i32 red = 1;
+
+    /**
+     * @brief Color of a black node, stored in Node::balance under RedBlack
+     */
+    static constexpr i32 black = 0;
+
+    /**
+     * @brief Where a descent for a key ended up
+     */
+    struct Descent {
+      /**
+       * @brief Last node on the path, the parent for a new node with the key
+       * (nullptr if the tree is empty)
+       */
+      Node* parent;
+
+      /**
+       * @brief First node whose key is not less than the key (nullptr if
+       * there is none), the only possible match
+       */
+      Node* bound;
+    };
+
+    /**
+     * @brief What is left behind after a node is spliced out of the tree
+     */
+    struct Splice {
+      /**
+       * @brief Lowest node whose subtree changed (the header if it was the
+       * root)
+       */
+      Node* parent;
+
+      /**
+       * @brief Node that moved up into the vacated position (may be nullptr)
+       */
+      Node* child;
+
+      /**
+       * @brief Balance / color of the node that left its position
+       */
+      i32 removed;
+    };
+
+    /**
+     * @brief Allocates a node and constructs it with the given arguments
+     */
+    template<typename... Args>
+    auto create_node(Args&&... args) -> Node*;
+
+    /**
+     * @brief Looks the key up and, if it is missing, links in a new node
+     * whose value is built from 'args'. Returns the node with the key and
+     * whether it is new
+     */
+    template<typename KeyArg, typename... Args>
+    auto try_emplace_node(KeyArg&& key, Args&&... args)
+      -> std::pair<Node*, bool>;
+
+    /**
+     * @brief Links a new node below 'parent' (as the root if that is nullptr)
+     * and restores the balance
+     */
+    auto attach(Node* node, Node* parent, bool on_left) -> void;
+
+    /**
+     * @brief Destroys and frees a single node
+     */
+    auto destroy_node(Node* node) -> void;
+
+    /**
+     * @brief Destroys and frees the given subtree, parent links are ignored
+     */
+    auto destroy(Node* node) -> void;
+
+    /**
+     * @brief Deep copies the tree under the given root, iteratively and with
+     * the copies linked to their own parents
+     */
+    auto clone(const Node* source) -> Node*;
+
+    /**
+     * @brief What the Augment policy keeps about a single node, from
+     * leaf(key) if it has one and leaf(key, value) otherwise
+     */
+    static auto leaf_aggregate(const K& key, const V& value)
+      -> typename Augment::value_type;
+
+    /**
+     * @brief Recomputes the aggregates above a node whose value was assigned
+     */
+    auto reaggregate(Node* node) -> void;
+
+    /**
+     * @brief Hangs the current root under the header and points the header
+     * at the smallest and greatest nodes, after the root was replaced
+     * wholesale
+     */
+    auto reset_header() -> void;
+
+    /**
+     * @brief Links the next n nodes of a list threaded through their right
+     * pointers into a balanced subtree, moving 'list' past them. Nodes as
+     * deep as 'bottom' are colored red under RedBlack
+     */
+    auto build(Node*& list, usize n, usize depth, usize bottom) -> Node*;
+
+    /**
+     * @brief Makes the list of n nodes (in key order, threaded through their
+     * right pointers) the whole tree, the map must be empty
+     */
+    auto adopt(Node* list, usize n) -> void;
+
+    /**
+     * @brief Takes every node out of the tree as a list in key order,
+     * threaded through the right pointers. The map is left empty
+     */
+    auto release() -> Node*;
+
+    /**
+     * @brief Moves the nodes of 'other' over one at a time, for when it is
+     * smaller than this map
+     */
+    auto merge_nodes(BSTmap& other) -> void;
+
+    /**
+     * @brief Moves the keys and values of 'other' over, for allocators that
+     * cannot free each other's nodes
+     */
+    auto merge_values(BSTmap& other) -> void;
+
+    /**
+     * @brief Lets the allocator set up room for n nodes up front, if it can
+     */
+    auto reserve_nodes(usize n) -> void;
+
     /**
      * @brief Gets how deep the given node is
      */
     [[nodiscard]] auto getdepth(const Node& node) const -> usize;
 
     /**
-     * @brief Gets the node with the given key, or what its parent should be
+     * @brief Size of the subtree under the given node (0 for nullptr)
+     */
+    [[nodiscard]] static auto subtree_size(const Node* node) -> usize;
+
+    /**
+     * @brief Gets the node at the given position in key order, nullptr if
+     * there is none
+     */
+    auto select_node(usize index) const -> Node*;
+
+    /**
+     * @brief Descends from the root with one comparison per level, the core
+     * of every lookup and insert
+     */
+    template<typename Key>
+    auto index(const Key& key) const -> Descent;
+
+    /**
+     * @brief Same descent through the subtree under 'from' only
+     */
+    template<typename Key>
+    auto index(const Key& key, Node* from) const -> Descent;
+
+    /**
+     * @brief Same result as index, but branching on every comparison and
+     * stopping at the key, where index goes on to the bottom. For Splay,
+     * which keeps the keys asked for most near the root
+     */
+    template<typename Key>
+    auto search(const Key& key) const -> Descent;
+
+    /**
+     * @brief Climbs from the finger (a node a descent for a smaller or equal
+     * key went through) to the lowest ancestor whose subtree holds the place
+     * of the given key, where a descent for it can start
+     */
+    template<typename Key>
+    auto climb(Node* finger, const Key& key) const -> Node*;
+
+    /**
+     * @brief Finds the node for each key of the container, nullptr when it is
+     * missing
+     */
+    template<typename Keys>
+    auto find_batch_nodes(const Keys& keys) const -> std::vector<Node*>;
+
+    /**
+     * @brief Lower bounds for a group of up to batch_lanes sorted keys,
+     * key_at(i) being the i-th. One descent covers the path the group has in
+     * common, after that every key moves down a level per round, so the
+     * cache misses of different keys overlap instead of queueing up
+     */
+    template<typename KeyAt>
+    auto lower_bounds(usize lanes, KeyAt key_at, Node** bounds) const -> void;
+
+    /**
+     * @brief Is the lower bound found for a key equivalent to it
      */
-    auto index(Node* node, const K& key) const -> Node*;
+    template<typename Key>
+    auto is_match(const Node* bound, const Key& key) const -> bool;
 
     /**
-     * @brief Root of the tree
+     * @brief Gets the node with the given key, nullptr if there is none
+     */
+    template<typename Key>
+    auto find_node(const Key& key) const -> Node*;
+
+    /**
+     * @brief find_node for the non-const lookups. Under Splay the node found
+     * (or the last one looked at if there is none) is splayed to the root
+     */
+    template<typename Key>
+    auto access(const Key& key) -> Node*;
+
+    /**
+     * @brief Gets the first node whose key is not less than the given key,
+     * nullptr if there is none
+     */
+    template<typename Key>
+    auto lower_bound_node(const Key& key) const -> Node*;
+
+    /**
+     * @brief Gets the first node whose key is greater than the given key,
+     * nullptr if there is none
+     */
+    template<typename Key>
+    auto upper_bound_node(const Key& key) const -> Node*;
+
+    /**
+     * @brief Puts the subtree 'with' in place of the subtree 'node' under the
+     * parent of 'node'
+     */
+    auto transplant(Node* node, Node* with) -> void;
+
+    /**
+     * @brief Rotates the right child of the given node above it, returns the
+     * new root of the subtree
+     */
+    auto rotate_left(Node* node) -> Node*;
+
+    /**
+     * @brief Rotates the left child of the given node above it, returns the
+     * new root of the subtree
+     */
+    auto rotate_right(Node* node) -> Node*;
+
+    /**
+     * @brief Rotates the node up to the root, two levels at a time where it
+     * can: a node on the same side as its parent has the grandparent turned
+     * first, which roughly halves the depth of the whole path
+     */
+    auto splay(Node* node) -> void;
+
+    /**
+     * @brief Unlinks the node from the tree, its in-order successor takes its
+     * place if it has two children. The node itself is not freed
+     */
+    auto splice(Node* node) -> Splice;
+
+    /**
+     * @brief Walks up from a node whose children changed, fixing heights
+     * (and under AVL rotating any node whose balance left [-1, 1]) until a
+     * subtree keeps its height
+     */
+    auto rebalance(Node* node) -> void;
+
+    /**
+     * @brief Fixes the heights above a subtree that was just rotated
+     */
+    auto refresh_above(Node* node) -> void;
+
+    /**
+     * @brief Restores the red-black rules after the given red node was linked
+     */
+    auto fix_red_insert(Node* node) -> void;
+
+    /**
+     * @brief Restores the red-black rules after a black node was spliced out
+     * from above 'node' (which may be nullptr) under 'parent'
+     */
+    auto fix_red_erase(Node* node, Node* parent) -> void;
+
+    /**
+     * @brief Is the node red, nullptr leaves are black
+     */
+    [[nodiscard]] static auto is_red(const Node* node) -> bool;
+
+    /**
+     * @brief Key ordering
+     */
+    Compare comp;
+
+    /**
+     * @brief Allocates every node of the tree
+     */
+    node_allocator alloc;
+
+    /**
+     * @brief Sentinel above the root and the end() position, like the
+     * libstdc++ tree header. Its left is the node with the smallest key
+     * (where begin() starts), its right the node with the greatest key (what
+     * end() steps back to), both the header itself when the map is empty
+     */
+    Node header;
+
+    /**
+     * @brief Root of the tree, its parent is the header
      */
     Node* root = nullptr;
 
@@ -449,13 +1351,27 @@ namespace CS280 {
      * @brief Size of the tree
      */
     usize count = 0;
+
+    /**
+     * @brief Work counters
+     */
+    Stats stats{};
   };
 
   /**
    * @brief Prints out the bst map to the stream
    */
-  template<typename K, typename V>
-  auto operator<<(std::ostream& os, const BSTmap<K, V>& map) -> std::ostream&;
+  template<
+    typename K,
+    typename V,
+    typename Balance,
+    typename Compare,
+    typename Allocator,
+    typename Augment>
+  auto operator<<(
+    std::ostream& os,
+    const BSTmap<K, V, Balance, Compare, Allocator, Augment>& map
+  ) -> std::ostream&;
 } // namespace CS280
 
 #ifndef BSTMAP_CPP
@@ -0,0 +1,772 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#ifndef COMPACT_BSTMAP_H
+#include "compact-bst-map.h"
+#endif
+
+#ifndef COMPACT_BSTMAP_CPP
+#define COMPACT_BSTMAP_CPP
+
+namespace CS280 {
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  template<typename KeyArg, typename... Args>
+  CompactBSTmap<K, V, Compare, Allocator>::Node::Node(
+    u32 parent,
+    KeyArg&& key,
+    Args&&... args
+  ):
+      key(std::forward<KeyArg>(key)),
+      value(std::forward<Args>(args)...),
+      left{none},
+      right{none},
+      link{parent | (u32{1} << 30)} {}
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::Node::Key() const -> const K& {
+    return key;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::Node::Value() -> V& {
+    return value;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::Node::Value() const
+    -> const V& {
+    return value;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::Node::parent() const -> u32 {
+    return link & none;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::Node::balance() const -> i32 {
+    return static_cast<i32>(link >> 30) - 1;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::Node::set_parent(u32 parent)
+    -> void {
+    link = (link & ~none) | parent;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::Node::set_balance(i32 balance)
+    -> void {
+    link = (link & none) | (static_cast<u32>(balance + 1) << 30);
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  CompactBSTmap<K, V, Compare, Allocator>::iterator::iterator(
+    CompactBSTmap* map,
+    u32 index
+  ):
+      map{map},
+      index{index} {}
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator++()
+    -> iterator& {
+    index = map->successor(index);
+    return *this;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator++(int)
+    -> iterator {
+    iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator--()
+    -> iterator& {
+    index = map->predecessor(index);
+    return *this;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator--(int)
+    -> iterator {
+    iterator old = *this;
+    --*this;
+    return old;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator*() const
+    -> Node& {
+    return map->nodes[index];
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator->() const
+    -> Node* {
+    return &map->nodes[index];
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator!=(
+    const iterator& rhs
+  ) const -> bool {
+    return index != rhs.index or map != rhs.map;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::iterator::operator==(
+    const iterator& rhs
+  ) const -> bool {
+    return index == rhs.index and map == rhs.map;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  CompactBSTmap<K, V, Compare, Allocator>::const_iterator::const_iterator(
+    const CompactBSTmap* map,
+    u32 index
+  ):
+      map{map},
+      index{index} {}
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator++()
+    -> const_iterator& {
+    index = map->successor(index);
+    return *this;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator++(int)
+    -> const_iterator {
+    const_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator--()
+    -> const_iterator& {
+    index = map->predecessor(index);
+    return *this;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator--(int)
+    -> const_iterator {
+    const_iterator old = *this;
+    --*this;
+    return old;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator*()
+    const -> const Node& {
+    return map->nodes[index];
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator->()
+    const -> const Node* {
+    return &map->nodes[index];
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator!=(
+    const const_iterator& rhs
+  ) const -> bool {
+    return index != rhs.index or map != rhs.map;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::const_iterator::operator==(
+    const const_iterator& rhs
+  ) const -> bool {
+    return index == rhs.index and map == rhs.map;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  CompactBSTmap<K, V, Compare, Allocator>::CompactBSTmap():
+      comp{},
+      nodes{},
+      root{none} {}
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  CompactBSTmap<K, V, Compare, Allocator>::CompactBSTmap(
+    const Compare& comp,
+    const Allocator& alloc
+  ):
+      comp{comp},
+      nodes{node_allocator(alloc)},
+      root{none} {}
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  CompactBSTmap<K, V, Compare, Allocator>::CompactBSTmap(CompactBSTmap&& from):
+      comp{std::move(from.comp)},
+      nodes{std::move(from.nodes)},
+      root{std::exchange(from.root, none)} {
+    from.nodes.clear();
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::operator=(CompactBSTmap&& rhs)
+    -> CompactBSTmap& {
+    if (this == &rhs) {
+      return *this;
+    }
+
+    comp = std::move(rhs.comp);
+    nodes = std::move(rhs.nodes);
+    root = std::exchange(rhs.root, none);
+    rhs.nodes.clear();
+
+    return *this;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::size() const -> usize {
+    return nodes.size();
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::empty() const -> bool {
+    return nodes.empty();
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::clear() -> void {
+    nodes.clear();
+    root = none;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::reserve(usize n) -> void {
+    nodes.reserve(std::min<usize>(n, none));
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::shrink_to_fit() -> void {
+    nodes.shrink_to_fit();
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::operator[](const K& key)
+    -> V& {
+    return try_emplace(key).first->Value();
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  template<typename... Args>
+  auto CompactBSTmap<K, V, Compare, Allocator>::try_emplace(
+    const K& key,
+    Args&&... args
+  ) -> std::pair<iterator, bool> {
+    u32 parent = none;
+    u32 bound = none;
+    bool on_left = false;
+
+    // one comparison per level, the lower bound settles a match at the end
+    for (u32 at = root; at != none;) {
+      const Node& node = nodes[at];
+
+      parent = at;
+      on_left = not comp(node.key, key);
+      bound = on_left ? at : bound;
+      at = on_left ? node.left : node.right;
+    }
+
+    if (bound != none and not comp(key, nodes[bound].key)) {
+      return {iterator{this, bound}, false};
+    }
+
+    if (nodes.size() >= none) {
+      throw std::length_error("CompactBSTmap is out of 30 bit indices");
+    }
+
+    const u32 at = static_cast<u32>(nodes.size());
+    nodes.emplace_back(parent, key, std::forward<Args>(args)...);
+
+    if (parent == none) {
+      root = at;
+    } else if (on_left) {
+      nodes[parent].left = at;
+    } else {
+      nodes[parent].right = at;
+    }
+
+    retrace_insert(at);
+
+    return {iterator{this, at}, true};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::begin() -> iterator {
+    return iterator{this, first(root)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::end() -> iterator {
+    return iterator{this, none};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::rbegin() -> reverse_iterator {
+    return reverse_iterator{end()};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::rend() -> reverse_iterator {
+    return reverse_iterator{begin()};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::find(const K& key)
+    -> iterator {
+    return iterator{this, find_index(key)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::lower_bound(const K& key)
+    -> iterator {
+    return iterator{this, lower_bound_index(key)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::upper_bound(const K& key)
+    -> iterator {
+    return iterator{this, upper_bound_index(key)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::erase(iterator it) -> void {
+    erase_index(it.index);
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::erase(const K& key) -> usize {
+    const u32 at = find_index(key);
+
+    if (at == none) {
+      return 0;
+    }
+
+    erase_index(at);
+    return 1;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::begin() const
+    -> const_iterator {
+    return const_iterator{this, first(root)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::end() const -> const_iterator {
+    return const_iterator{this, none};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::rbegin() const
+    -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::rend() const
+    -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::find(const K& key) const
+    -> const_iterator {
+    return const_iterator{this, find_index(key)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::lower_bound(const K& key) const
+    -> const_iterator {
+    return const_iterator{this, lower_bound_index(key)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::upper_bound(const K& key) const
+    -> const_iterator {
+    return const_iterator{this, upper_bound_index(key)};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::contains(const K& key) const
+    -> bool {
+    return find_index(key) != none;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::sanityCheck() const -> bool {
+    usize height = 0;
+
+    if (not check(root, none, height)) {
+      return false;
+    }
+
+    usize visited = 0;
+    for (u32 at = first(root); at != none;) {
+      visited++;
+
+      const u32 next = successor(at);
+      if (next != none and not comp(nodes[at].key, nodes[next].key)) {
+        return false;
+      }
+
+      at = next;
+    }
+
+    return visited == nodes.size();
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::first(u32 at) const -> u32 {
+    if (at == none) {
+      return none;
+    }
+
+    while (nodes[at].left != none) {
+      at = nodes[at].left;
+    }
+
+    return at;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::last(u32 at) const -> u32 {
+    if (at == none) {
+      return none;
+    }
+
+    while (nodes[at].right != none) {
+      at = nodes[at].right;
+    }
+
+    return at;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::successor(u32 at) const
+    -> u32 {
+    if (nodes[at].right != none) {
+      return first(nodes[at].right);
+    }
+
+    // climb until we come up out of a left subtree
+    u32 parent = nodes[at].parent();
+    while (parent != none and nodes[parent].right == at) {
+      at = parent;
+      parent = nodes[at].parent();
+    }
+
+    return parent;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::predecessor(u32 at) const
+    -> u32 {
+    if (at == none) {
+      return last(root);
+    }
+
+    if (nodes[at].left != none) {
+      return last(nodes[at].left);
+    }
+
+    u32 parent = nodes[at].parent();
+    while (parent != none and nodes[parent].left == at) {
+      at = parent;
+      parent = nodes[at].parent();
+    }
+
+    return parent;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::lower_bound_index(
+    const K& key
+  ) const -> u32 {
+    const Node* const base = nodes.data();
+    u32 bound = none;
+
+    for (u32 at = root; at != none;) {
+      const bool less = comp(base[at].key, key);
+
+      bound = less ? bound : at;
+      at = less ? base[at].right : base[at].left;
+    }
+
+    return bound;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::upper_bound_index(
+    const K& key
+  ) const -> u32 {
+    const Node* const base = nodes.data();
+    u32 bound = none;
+
+    for (u32 at = root; at != none;) {
+      const bool greater = comp(key, base[at].key);
+
+      bound = greater ? at : bound;
+      at = greater ? base[at].left : base[at].right;
+    }
+
+    return bound;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::find_index(const K& key) const
+    -> u32 {
+    const u32 bound = lower_bound_index(key);
+
+    if (bound != none and not comp(key, nodes[bound].key)) {
+      return bound;
+    }
+
+    return none;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::replace_child(
+    u32 parent,
+    u32 from,
+    u32 to
+  ) -> void {
+    if (parent == none) {
+      root = to;
+    } else if (nodes[parent].left == from) {
+      nodes[parent].left = to;
+    } else {
+      nodes[parent].right = to;
+    }
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::rotate_left(u32 at) -> u32 {
+    const u32 pivot = nodes[at].right;
+    const u32 inner = nodes[pivot].left;
+    const u32 parent = nodes[at].parent();
+
+    nodes[at].right = inner;
+    if (inner != none) {
+      nodes[inner].set_parent(at);
+    }
+
+    replace_child(parent, at, pivot);
+    nodes[pivot].set_parent(parent);
+    nodes[pivot].left = at;
+    nodes[at].set_parent(pivot);
+
+    return pivot;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::rotate_right(u32 at) -> u32 {
+    const u32 pivot = nodes[at].left;
+    const u32 inner = nodes[pivot].right;
+    const u32 parent = nodes[at].parent();
+
+    nodes[at].left = inner;
+    if (inner != none) {
+      nodes[inner].set_parent(at);
+    }
+
+    replace_child(parent, at, pivot);
+    nodes[pivot].set_parent(parent);
+    nodes[pivot].right = at;
+    nodes[at].set_parent(pivot);
+
+    return pivot;
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::rotate_back(u32 at, i32 b)
+    -> std::pair<u32, bool> {
+    // the +-2 is never stored, the two bits only hold -1 to 1
+    const bool right_heavy = b > 0;
+    const u32 child = right_heavy ? nodes[at].right : nodes[at].left;
+    const i32 lean = right_heavy ? nodes[child].balance()
+                                 : -nodes[child].balance();
+
+    if (lean >= 0) {
+      // single rotation, a child in balance (only after an erase) leaves
+      // the subtree as tall as before
+      if (right_heavy) {
+        rotate_left(at);
+      } else {
+        rotate_right(at);
+      }
+
+      const i32 side = right_heavy ? 1 : -1;
+      nodes[at].set_balance(lean == 0 ? side : 0);
+      nodes[child].set_balance(lean == 0 ? -side : 0);
+
+      return {child, lean != 0};
+    }
+
+    // double rotation, the grandchild ends up on top
+    const u32 grandchild = right_heavy ? nodes[child].left : nodes[child].right;
+    const i32 g = nodes[grandchild].balance();
+
+    if (right_heavy) {
+      rotate_right(child);
+      rotate_left(at);
+      nodes[at].set_balance(g > 0 ? -1 : 0);
+      nodes[child].set_balance(g < 0 ? 1 : 0);
+    } else {
+      rotate_left(child);
+      rotate_right(at);
+      nodes[at].set_balance(g < 0 ? 1 : 0);
+      nodes[child].set_balance(g > 0 ? -1 : 0);
+    }
+    nodes[grandchild].set_balance(0);
+
+    return {grandchild, true};
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::retrace_insert(u32 at)
+    -> void {
+    for (u32 parent = nodes[at].parent(); parent != none;
+         at = parent, parent = nodes[at].parent()) {
+      const i32 b =
+        nodes[parent].balance() + (nodes[parent].left == at ? -1 : 1);
+
+      if (b == 0) {
+        nodes[parent].set_balance(0);
+        return;
+      }
+
+      if (b == 1 or b == -1) {
+        nodes[parent].set_balance(b);
+        continue;
+      }
+
+      // after an insert one rotation always restores the old height
+      rotate_back(parent, b);
+      return;
+    }
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::retrace_erase(
+    u32 parent,
+    bool from_left
+  ) -> void {
+    for (u32 at = parent; at != none;) {
+      const i32 b = nodes[at].balance() + (from_left ? 1 : -1);
+
+      // leaning one way now, the subtree is as tall as before
+      if (b == 1 or b == -1) {
+        nodes[at].set_balance(b);
+        return;
+      }
+
+      u32 top = at;
+      if (b == 0) {
+        nodes[at].set_balance(0);
+      } else {
+        const auto [rotated, shorter] = rotate_back(at, b);
+        if (not shorter) {
+          return;
+        }
+        top = rotated;
+      }
+
+      at = nodes[top].parent();
+      from_left = at != none and nodes[at].left == top;
+    }
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::erase_index(u32 at) -> void {
+    if (nodes[at].left != none and nodes[at].right != none) {
+      // the successor has no left child, its key and value move up here and
+      // its slot goes instead
+      const u32 next = first(nodes[at].right);
+      nodes[at].key = std::move(nodes[next].key);
+      nodes[at].value = std::move(nodes[next].value);
+      at = next;
+    }
+
+    const u32 parent = nodes[at].parent();
+    const u32 child =
+      nodes[at].left != none ? nodes[at].left : nodes[at].right;
+    const bool from_left = parent != none and nodes[parent].left == at;
+
+    replace_child(parent, at, child);
+    if (child != none) {
+      nodes[child].set_parent(parent);
+    }
+
+    retrace_erase(parent, from_left);
+    fill_slot(at);
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::fill_slot(u32 at) -> void {
+    const u32 moved = static_cast<u32>(nodes.size() - 1);
+
+    if (at != moved) {
+      nodes[at] = std::move(nodes[moved]);
+
+      Node& node = nodes[at];
+      replace_child(node.parent(), moved, at);
+      if (node.left != none) {
+        nodes[node.left].set_parent(at);
+      }
+      if (node.right != none) {
+        nodes[node.right].set_parent(at);
+      }
+    }
+
+    nodes.pop_back();
+  }
+
+  template<typename K, typename V, typename Compare, typename Allocator>
+  auto CompactBSTmap<K, V, Compare, Allocator>::check(
+    u32 at,
+    u32 parent,
+    usize& height
+  ) const -> bool {
+    if (at == none) {
+      height = 0;
+      return true;
+    }
+
+    if (at >= nodes.size() or nodes[at].parent() != parent) {
+      return false;
+    }
+
+    usize left_height = 0;
+    usize right_height = 0;
+
+    if (not check(nodes[at].left, at, left_height) or
+        not check(nodes[at].right, at, right_height)) {
+      return false;
+    }
+
+    const i32 balance =
+      static_cast<i32>(right_height) - static_cast<i32>(left_height);
+
+    if (balance != nodes[at].balance() or balance < -1 or balance > 1) {
+      return false;
+    }
+
+    height = std::max(left_height, right_height) + 1;
+    return true;
+  }
+} // namespace CS280
+
+#endif
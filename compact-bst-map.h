@@ -0,0 +1,538 @@
+#ifndef COMPACT_BSTMAP_H
+#define COMPACT_BSTMAP_H
+
+#include "types.h"
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace CS280 {
+
+  /**
+   * @brief AVL tree whose nodes live side by side in one vector and link to
+   * each other by 32 bit index instead of by pointer. The parent index and
+   * the balance factor share a word, so a node carries 12 bytes on top of
+   * its key and value (against 48 for a BSTmap node) and there is one heap
+   * block for the whole tree instead of one per node.
+   *
+   * Iterators are indices, so they survive the vector growing. References to
+   * keys and values do not, and an erase can move any node to another slot
+   * (the last one fills the hole), which invalidates every iterator
+   *
+   * @tparam K Key, must be move assignable
+   * @tparam V Value, must be move assignable
+   * @tparam Compare Strict weak ordering on keys
+   * @tparam Allocator Allocator for the key / value pairs, rebound to
+   * allocate the node vector
+   */
+  template<
+    typename K,
+    typename V,
+    typename Compare = std::less<K>,
+    typename Allocator = std::allocator<std::pair<const K, V>>>
+  class CompactBSTmap {
+
+  public:
+
+    class iterator;
+    class const_iterator;
+
+    /**
+     * @class Node
+     * @brief Key and value with the links to the other nodes
+     */
+    class Node {
+    public:
+
+      /**
+       * @brief Leaf constructor, the key is built from 'k' and the value in
+       * place from 'args'
+       */
+      template<typename KeyArg, typename... Args>
+      Node(u32 p, KeyArg&& k, Args&&... args);
+
+      /**
+       * @brief Gets the key stored
+       */
+      auto Key() const -> const K&;
+
+      /**
+       * @brief Gets the value stored
+       */
+      auto Value() -> V&;
+
+      /**
+       * @brief Gets the value stored
+       */
+      auto Value() const -> const V&;
+
+      friend class CompactBSTmap;
+
+    private:
+
+      /**
+       * @brief Index of the parent, 'none' for the root
+       */
+      auto parent() const -> u32;
+
+      /**
+       * @brief Height of the right subtree minus that of the left one
+       */
+      auto balance() const -> i32;
+
+      /**
+       * @brief Sets the index of the parent
+       */
+      auto set_parent(u32 p) -> void;
+
+      /**
+       * @brief Sets the balance factor, one of -1, 0 or 1
+       */
+      auto set_balance(i32 b) -> void;
+
+      /**
+       * @brief Key, only ever moved when a node changes slots
+       */
+      K key;
+
+      /**
+       * @brief Value
+       */
+      V value;
+
+      /**
+       * @brief Index of the left child, 'none' if there is none
+       */
+      u32 left;
+
+      /**
+       * @brief Index of the right child, 'none' if there is none
+       */
+      u32 right;
+
+      /**
+       * @brief Index of the parent in the low 30 bits, balance factor plus
+       * one in the top two
+       */
+      u32 link;
+    };
+
+    /**
+     * @class iterator
+     * @brief Iterator for a non-const map, a map and a slot in it
+     */
+    class iterator {
+    public:
+
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Node;
+      using difference_type = std::ptrdiff_t;
+      using pointer = Node*;
+      using reference = Node&;
+
+      /**
+       * @brief Default / normal constructor
+       */
+      iterator(CompactBSTmap* m = nullptr, u32 i = none);
+
+      /**
+       * @brief Pre-increment, move to the next
+       */
+      auto operator++() -> iterator&;
+
+      /**
+       * @brief Post-increment, returns the current and after move to the next
+       */
+      auto operator++(int) -> iterator;
+
+      /**
+       * @brief Pre-decrement, move to the previous (end to the last)
+       */
+      auto operator--() -> iterator&;
+
+      /**
+       * @brief Post-decrement, returns the current and after move to the
+       * previous
+       */
+      auto operator--(int) -> iterator;
+
+      /**
+       * @brief Gets the inner node
+       */
+      [[nodiscard]] auto operator*() const -> Node&;
+
+      /**
+       * @brief Gets the inner node
+       */
+      auto operator->() const -> Node*;
+
+      /**
+       * @brief Checks if this and another iterator are not equal
+       */
+      [[nodiscard]] auto operator!=(const iterator& rhs) const -> bool;
+
+      /**
+       * @brief Checks if this and another iterator are equal
+       */
+      [[nodiscard]] auto operator==(const iterator& rhs) const -> bool;
+
+      friend class CompactBSTmap;
+
+    private:
+
+      /**
+       * @brief Map the node lives in
+       */
+      CompactBSTmap* map;
+
+      /**
+       * @brief Slot of the node, 'none' for end()
+       */
+      u32 index;
+    };
+
+    /**
+     * @class const_iterator
+     * @brief Iterator for a const map
+     */
+    class const_iterator {
+    public:
+
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Node;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Node*;
+      using reference = const Node&;
+
+      /**
+       * @brief Default / normal constructor
+       */
+      const_iterator(const CompactBSTmap* m = nullptr, u32 i = none);
+
+      /**
+       * @brief Pre-increment
+       */
+      auto operator++() -> const_iterator&;
+
+      /**
+       * @brief Post-increment
+       */
+      auto operator++(int) -> const_iterator;
+
+      /**
+       * @brief Pre-decrement
+       */
+      auto operator--() -> const_iterator&;
+
+      /**
+       * @brief Post-decrement
+       */
+      auto operator--(int) -> const_iterator;
+
+      /**
+       * @brief Gets a reference to the inner node
+       */
+      auto operator*() const -> const Node&;
+
+      /**
+       * @brief Gets the inner node
+       */
+      auto operator->() const -> const Node*;
+
+      /**
+       * @brief Checks if this and another iter is not equal
+       */
+      auto operator!=(const const_iterator& rhs) const -> bool;
+
+      /**
+       * @brief Checks if this and another iter is equal
+       */
+      auto operator==(const const_iterator& rhs) const -> bool;
+
+      friend class CompactBSTmap;
+
+    private:
+
+      /**
+       * @brief Map the node lives in
+       */
+      const CompactBSTmap* map;
+
+      /**
+       * @brief Slot of the node, 'none' for end()
+       */
+      u32 index;
+    };
+
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    /**
+     * @brief Index that stands for no node, also the most nodes a map can
+     * hold
+     */
+    static constexpr u32 none = (u32{1} << 30) - 1;
+
+    /**
+     * @brief Default constructor
+     */
+    CompactBSTmap();
+
+    /**
+     * @brief Constructor with a comparator (and allocator)
+     */
+    explicit CompactBSTmap(
+      const Compare& comp,
+      const Allocator& alloc = Allocator()
+    );
+
+    /**
+     * @brief Copy constructor, one copy of the node vector
+     */
+    CompactBSTmap(const CompactBSTmap& rhs) = default;
+
+    /**
+     * @brief Move constructor, 'from' is left empty
+     */
+    CompactBSTmap(CompactBSTmap&& from);
+
+    /**
+     * @brief Copy assignment
+     */
+    auto operator=(const CompactBSTmap& rhs) -> CompactBSTmap& = default;
+
+    /**
+     * @brief Move assignment, 'rhs' is left empty
+     */
+    auto operator=(CompactBSTmap&& rhs) -> CompactBSTmap&;
+
+    /**
+     * @brief Destructor
+     */
+    ~CompactBSTmap() = default;
+
+    /**
+     * @brief Gets the number of elements in the map
+     */
+    auto size() const -> usize;
+
+    /**
+     * @brief Checks if the map is empty
+     */
+    auto empty() const -> bool;
+
+    /**
+     * @brief Removes every element, the node vector keeps its capacity
+     */
+    auto clear() -> void;
+
+    /**
+     * @brief Makes room for n nodes, so growing up to n needs no reallocation
+     */
+    auto reserve(usize n) -> void;
+
+    /**
+     * @brief Gives back node slots the map no longer uses
+     */
+    auto shrink_to_fit() -> void;
+
+    /**
+     * @brief Gets the value of the given key, inserting a default value first
+     * if it is not there
+     */
+    auto operator[](const K& key) -> V&;
+
+    /**
+     * @brief Inserts the key with a value built from 'args' unless the key is
+     * already there, either way returns where it is
+     */
+    template<typename... Args>
+    auto try_emplace(const K& key, Args&&... args) -> std::pair<iterator, bool>;
+
+    auto begin() -> iterator;
+
+    auto end() -> iterator;
+
+    auto rbegin() -> reverse_iterator;
+
+    auto rend() -> reverse_iterator;
+
+    /**
+     * @brief Gets the element with the given key, or end()
+     */
+    auto find(const K& key) -> iterator;
+
+    /**
+     * @brief Gets the first element whose key is not less than the given key
+     */
+    auto lower_bound(const K& key) -> iterator;
+
+    /**
+     * @brief Gets the first element whose key is greater than the given key
+     */
+    auto upper_bound(const K& key) -> iterator;
+
+    /**
+     * @brief Erases the element, invalidates every iterator
+     */
+    auto erase(iterator it) -> void;
+
+    /**
+     * @brief Erases the element with the given key, returns how many were
+     * erased (0 or 1)
+     */
+    auto erase(const K& key) -> usize;
+
+    auto begin() const -> const_iterator;
+
+    auto end() const -> const_iterator;
+
+    auto rbegin() const -> const_reverse_iterator;
+
+    auto rend() const -> const_reverse_iterator;
+
+    /**
+     * @brief Gets the element with the given key, or end()
+     */
+    auto find(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is not less than the given key
+     */
+    auto lower_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is greater than the given key
+     */
+    auto upper_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Is the key in the map
+     */
+    auto contains(const K& key) const -> bool;
+
+    /**
+     * @brief Checks the links, ordering, balance factors, AVL invariant and
+     * size
+     */
+    auto sanityCheck() const -> bool;
+
+  private:
+
+    using node_allocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+
+    /**
+     * @brief Slot of the leftmost node under 'at', 'none' for 'none'
+     */
+    auto first(u32 at) const -> u32;
+
+    /**
+     * @brief Slot of the rightmost node under 'at', 'none' for 'none'
+     */
+    auto last(u32 at) const -> u32;
+
+    /**
+     * @brief Slot of the next node in key order, 'none' after the last
+     */
+    auto successor(u32 at) const -> u32;
+
+    /**
+     * @brief Slot of the previous node in key order, the last node before
+     * 'none'
+     */
+    auto predecessor(u32 at) const -> u32;
+
+    /**
+     * @brief Slot of the first key not less than the given key
+     */
+    auto lower_bound_index(const K& key) const -> u32;
+
+    /**
+     * @brief Slot of the first key greater than the given key
+     */
+    auto upper_bound_index(const K& key) const -> u32;
+
+    /**
+     * @brief Slot of the given key, 'none' if it is not there
+     */
+    auto find_index(const K& key) const -> u32;
+
+    /**
+     * @brief Points whatever linked to 'from' (its parent or the root) at
+     * 'to' instead
+     */
+    auto replace_child(u32 parent, u32 from, u32 to) -> void;
+
+    /**
+     * @brief Rotates the right child of 'at' above it, returns that child,
+     * the balance factors are left to the caller
+     */
+    auto rotate_left(u32 at) -> u32;
+
+    /**
+     * @brief Rotates the left child of 'at' above it, returns that child,
+     * the balance factors are left to the caller
+     */
+    auto rotate_right(u32 at) -> u32;
+
+    /**
+     * @brief Rotates the subtree at 'at' back into shape when its balance
+     * factor would be 'b' (2 or -2), returns the new root of the subtree and
+     * whether it got shorter than before the rotation
+     */
+    auto rotate_back(u32 at, i32 b) -> std::pair<u32, bool>;
+
+    /**
+     * @brief Walks up from a new leaf fixing balance factors, rotates at most
+     * once
+     */
+    auto retrace_insert(u32 at) -> void;
+
+    /**
+     * @brief Walks up from 'parent', whose left or right subtree got one
+     * shorter, fixing balance factors and rotating where needed
+     */
+    auto retrace_erase(u32 parent, bool from_left) -> void;
+
+    /**
+     * @brief Unlinks and frees the node in slot 'at'
+     */
+    auto erase_index(u32 at) -> void;
+
+    /**
+     * @brief Moves the last node of the vector into the free slot 'at' and
+     * drops the last slot
+     */
+    auto fill_slot(u32 at) -> void;
+
+    /**
+     * @brief Checks the subtree at 'at' and works out its height
+     */
+    auto check(u32 at, u32 parent, usize& height) const -> bool;
+
+    /**
+     * @brief Key ordering
+     */
+    Compare comp;
+
+    /**
+     * @brief Every node, in the order they were inserted (give or take
+     * erases)
+     */
+    std::vector<Node, node_allocator> nodes;
+
+    /**
+     * @brief Slot of the root
+     */
+    u32 root = none;
+  };
+} // namespace CS280
+
+#ifndef COMPACT_BSTMAP_CPP
+#include "compact-bst-map.cpp"
+#endif
+#endif
@@ -1,23 +1,27 @@
 #include <random>
 #include <algorithm>
+#include <chrono>   // benchmarks
+#include <cmath>    // log2
 #include <iterator> // stream iterator
+#include <limits>   // numeric_limits
+#include <map>      // reference for batches
 #include <numeric>  // iota
 
+#include "bplus-tree-map.h"
 #include "bst-map.h"
+#include "compact-bst-map.h"
 #include <iostream>
 #include <vector>
 #include <cstdlib>
 #include <string>
+#include <string_view>
 
-void simple_inserts(
-  CS280::BSTmap<int, int>& map,
-  const std::vector<int>& data
-) {
+template<typename Map>
+void simple_inserts(Map& map, const std::vector<int>& data) {
   // insert (using index operator) and perform sanity check each time
   for (const int& key: data) {
     map[key] = key * key; // value is not important
-    // if you have the method below, uncomment next line
-    // if (!map.sanityCheck()) std::cout << "Error\n";
+    if (!map.sanityCheck()) std::cout << "Error\n";
   }
 }
 
@@ -46,10 +50,11 @@ void test2() {
 // implement basics of the iterator
 // and find
 
-void simple_finds(CS280::BSTmap<int, int>& map, const std::vector<int>& data) {
+template<typename Map>
+void simple_finds(Map& map, const std::vector<int>& data) {
   // insert all and perform sanity check each time
   for (const int& key: data) {
-    CS280::BSTmap<int, int>::iterator it = map.find(key);
+    typename Map::iterator it = map.find(key);
     if (it == map.end()) {
       std::cout << "cannot find value " << key << std::endl;
     }
@@ -65,20 +70,17 @@ void test3() {
 
 ////////////////////////////////////////////////
 // implement delete
-void simple_deletes(
-  CS280::BSTmap<int, int>& map,
-  const std::vector<int>& data
-) {
+template<typename Map>
+void simple_deletes(Map& map, const std::vector<int>& data) {
   // insert all and perform sanity check each time
   for (const int& key: data) {
-    CS280::BSTmap<int, int>::iterator it = map.find(key);
+    typename Map::iterator it = map.find(key);
 
     if (it == map.end()) {
       std::cout << "cannot find value " << key << std::endl;
     } else {
       map.erase(it);
-      // if you have the method below, uncomment next line
-      // if (!map.sanityCheck()) std::cout << "Error\n";
+      if (!map.sanityCheck()) std::cout << "Error\n";
     }
   }
 
@@ -133,6 +135,7 @@ void test6() {
 // now mix inserts and deletes
 // test is randomized, so no output provided:
 // check for crashes, check with valgrind
+template<typename Map = CS280::BSTmap<int, int>>
 void inserts_delete_random(
   int N,
   int num_iter,
@@ -141,7 +144,7 @@ void inserts_delete_random(
   float ratio_to_delete,    // 0..1
   bool perform_checks       // false - speed only, true - mostly correctness
 ) {
-  CS280::BSTmap<int, int> map;
+  Map map;
   std::vector<int> data(N);     // data to insert (i.e. NOT in the map )
   std::iota(data.begin(), data.end(), 1);
   std::vector<int> map_content; // initially empty
@@ -586,25 +589,2403 @@ void test13() {
   }
 }
 
-void (*pTests[])(void) = {
-  test0,
-  test1,
-  test2,
-  test3,
-  test4,
-  test5,
-  test6,
-  test7,
-  test8,
-  test9,
-  test10,
-  test11,
-  test12,
-  test13,
+////////////////////////////////////////////////
+// AVL balancing
+// ascending keys make a linked list in the plain tree,
+// with AVL the height stays logarithmic
+void test14() {
+  CS280::BSTmap<int, int, CS280::AVL> map;
+  std::vector<int> data(10);
+  std::iota(data.begin(), data.end(), 1);
+  simple_inserts(map, data);
+  std::cout << map << std::endl;
+  simple_deletes(map, std::vector<int>{4, 1, 2});
+  std::cout << map << std::endl;
+}
+
+// random inserts and deletes on an AVL tree
+// expected output - none
+void test15() {
+  inserts_delete_random<CS280::BSTmap<int, int, CS280::AVL>>(
+    1000,
+    10,
+    2,
+    12,
+    0.5,
+    true
+  );
+}
+
+////////////////////////////////////////////////
+// red-black balancing
+void test16() {
+  CS280::BSTmap<int, int, CS280::RedBlack> map;
+  std::vector<int> data(10);
+  std::iota(data.begin(), data.end(), 1);
+  simple_inserts(map, data);
+  std::cout << map << std::endl;
+  simple_deletes(map, std::vector<int>{4, 1, 2});
+  std::cout << map << std::endl;
+}
+
+// random inserts and deletes on a red-black tree
+// expected output - none
+void test17() {
+  inserts_delete_random<CS280::BSTmap<int, int, CS280::RedBlack>>(
+    1000,
+    10,
+    2,
+    12,
+    0.5,
+    true
+  );
+}
+
+////////////////////////////////////////////////
+// pool allocator
+// random inserts and deletes, then copies share nothing with the original
+// expected output - none
+void test18() {
+  typedef CS280::BSTmap<
+    int,
+    int,
+    CS280::AVL,
+    std::less<int>,
+    CS280::PoolAllocator<std::pair<const int, int>>>
+    PoolMap;
+
+  inserts_delete_random<PoolMap>(1000, 10, 2, 12, 0.5, true);
+
+  PoolMap map;
+  std::vector<int> data(100);
+  std::iota(data.begin(), data.end(), 1);
+  simple_inserts(map, data);
+  PoolMap copy(map);
+  simple_deletes(map, data);
+  simple_finds(copy, data);
+}
+
+// clear and reuse
+void test19() {
+  CS280::BSTmap<int, int> map;
+  std::vector<int> data{3, 4, 1, 5, 2};
+  simple_inserts(map, data);
+  map.clear();
+  if (!map.sanityCheck() or map.size() != 0 or map.begin() != map.end()) {
+    std::cout << "Error - map not empty after clear\n";
+  }
+  simple_inserts(map, std::vector<int>{2, 1, 3});
+  std::cout << map << std::endl;
+}
+
+// copy outlives the original, its links must not point into it
+// expected output - the copy, then the copy after erasing from it
+void test20() {
+  CS280::BSTmap<int, int>* map = new CS280::BSTmap<int, int>;
+  std::vector<int> data{3, 4, 1, 5, 2};
+  simple_inserts(*map, data);
+  CS280::BSTmap<int, int> copy(*map);
+  delete map;
+
+  if (!copy.sanityCheck()) std::cout << "Error\n";
+  std::cout << copy << std::endl;
+  simple_deletes(copy, std::vector<int>{3, 1});
+  std::cout << copy << std::endl;
+}
+
+// key that counts how many times one was built
+struct CountedKey {
+  std::string text;
+  static int built;
+
+  CountedKey(const char* text): text{text} { ++built; }
+
+  CountedKey(const CountedKey& rhs): text{rhs.text} { ++built; }
 };
 
-int main(int argc, char** argv) {
-  if (argc != 2) {
+int CountedKey::built = 0;
+
+// orders CountedKeys against each other and against plain string views
+struct CountedLess {
+  typedef void is_transparent;
+
+  bool operator()(const CountedKey& lhs, const CountedKey& rhs) const {
+    return lhs.text < rhs.text;
+  }
+
+  bool operator()(const CountedKey& lhs, std::string_view rhs) const {
+    return lhs.text < rhs;
+  }
+
+  bool operator()(std::string_view lhs, const CountedKey& rhs) const {
+    return lhs < rhs.text;
+  }
+};
+
+// lookups through a transparent comparator never build a key
+// expected output - out21
+void test21() {
+  CS280::BSTmap<CountedKey, int, CS280::AVL, CountedLess> map;
+  const char* words[] = {"delta", "alpha", "echo", "charlie", "bravo"};
+  for (const char* word: words) {
+    map[word] = static_cast<int>(std::string_view{word}.size());
+  }
+  std::cout << "built after inserts: " << CountedKey::built << "\n";
+
+  int before = CountedKey::built;
+  std::string_view probes[] = {"alpha", "echo", "foxtrot", "bravo", "a"};
+  for (std::string_view probe: probes) {
+    auto it = map.find(probe);
+    std::cout << probe << ": "
+              << (it != map.end() ? std::to_string(it->Value()) : "-")
+              << (map.contains(probe) ? " contained" : " missing")
+              << ", lower_bound "
+              << (map.lower_bound(probe) != map.end()
+                    ? map.lower_bound(probe)->Key().text
+                    : "end")
+              << "\n";
+  }
+  std::cout << "erased " << map.erase(std::string_view{"charlie"}) << " "
+            << map.erase(std::string_view{"charlie"}) << "\n";
+  std::cout << "built by lookups: " << CountedKey::built - before << "\n";
+  if (!map.sanityCheck()) std::cout << "Error\n";
+}
+
+// std::less that counts its calls into a shared counter
+template<typename T>
+struct CountingLess {
+  usize* calls;
+
+  bool operator()(const T& lhs, const T& rhs) const {
+    ++*calls;
+    return lhs < rhs;
+  }
+};
+
+// ordering comes from the comparator, and a lookup makes one comparison per
+// level plus one
+// expected output - out22
+void test22() {
+  CS280::BSTmap<int, int, CS280::AVL, std::greater<int>> reversed;
+  simple_inserts(reversed, std::vector<int>{1, 2, 3, 4, 5, 6, 7});
+  std::cout << reversed << std::endl;
+  for (auto it = reversed.begin(); it != reversed.end(); ++it) {
+    std::cout << it->Key() << " ";
+  }
+  std::cout << "\n";
+
+  usize calls = 0;
+  CS280::BSTmap<int, int, CS280::AVL, CountingLess<int>> map(
+    CountingLess<int>{&calls}
+  );
+  simple_inserts(map, std::vector<int>{4, 2, 6, 1, 3, 5, 7});
+  for (int key = 0; key <= 8; ++key) {
+    calls = 0;
+    bool found = map.find(key) != map.end();
+    std::cout << key << (found ? " found" : " missing") << " with " << calls
+              << " comparisons\n";
+  }
+}
+
+// value that counts how it was made
+struct Tracked {
+  static int copies;
+  static int moves;
+  int payload;
+
+  Tracked(): payload{0} {}
+
+  Tracked(int a, int b): payload{a * b} {}
+
+  Tracked(const Tracked& rhs): payload{rhs.payload} { ++copies; }
+
+  Tracked(Tracked&& rhs): payload{rhs.payload} { ++moves; }
+
+  Tracked& operator=(const Tracked& rhs) {
+    payload = rhs.payload;
+    ++copies;
+    return *this;
+  }
+
+  Tracked& operator=(Tracked&& rhs) {
+    payload = rhs.payload;
+    ++moves;
+    return *this;
+  }
+};
+
+int Tracked::copies = 0;
+int Tracked::moves = 0;
+
+void report(const char* what) {
+  std::cout << what << ": " << Tracked::copies << " copies, " << Tracked::moves
+            << " moves\n";
+  Tracked::copies = 0;
+  Tracked::moves = 0;
+}
+
+// values are built in place, nothing is copied and only handed over values
+// are moved
+// expected output - out23
+void test23() {
+  CS280::BSTmap<int, Tracked, CS280::RedBlack> map;
+  for (int key = 0; key < 8; ++key) {
+    map.try_emplace(key, key, 2);
+  }
+  report("try_emplace x8");
+  std::cout << "again inserted " << map.try_emplace(3, 0, 0).second << "\n";
+  report("try_emplace existing");
+  map.emplace(10, 5, 5);
+  report("emplace");
+  std::cout << "again inserted " << map.emplace(10, 1, 1).second << "\n";
+  report("emplace existing");
+  map[11].payload = 7;
+  report("operator[]");
+  std::cout << "inserted " << map.insert_or_assign(12, Tracked{3, 3}).second
+            << "\n";
+  report("insert_or_assign new");
+  std::cout << "inserted " << map.insert_or_assign(12, Tracked{4, 4}).second
+            << "\n";
+  report("insert_or_assign existing");
+  if (!map.sanityCheck()) std::cout << "Error\n";
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    std::cout << it->Key() << ":" << it->Value().payload << " ";
+  }
+  std::cout << "\n";
+
+  CountedKey::built = 0;
+  CS280::BSTmap<CountedKey, int, CS280::AVL, CountedLess> words;
+  words.emplace("alpha", 1);
+  words.try_emplace(CountedKey{"bravo"}, 2);
+  std::cout << "keys built: " << CountedKey::built << "\n";
+
+  CS280::BSTmap<int, std::unique_ptr<int>, CS280::AVL> owners;
+  owners.try_emplace(2, new int{20});
+  owners.emplace(1, new int{10});
+  owners[3] = std::make_unique<int>(30);
+  owners.insert_or_assign(1, std::make_unique<int>(11));
+  for (auto it = owners.begin(); it != owners.end(); ++it) {
+    std::cout << it->Key() << ":" << *it->Value() << " ";
+  }
+  std::cout << "\n";
+}
+
+// bounds and windows over the keys 0, 10, ..., 90
+// expected output - out24
+void test24() {
+  CS280::BSTmap<int, int, CS280::RedBlack> map;
+  for (int key = 0; key < 100; key += 10) {
+    map[key] = key / 10;
+  }
+
+  int probes[] = {-5, 0, 35, 40, 90, 95};
+  for (int probe: probes) {
+    auto lower = map.lower_bound(probe);
+    auto upper = map.upper_bound(probe);
+    auto [first, last] = map.equal_range(probe);
+    std::cout << probe << ": lower "
+              << (lower != map.end() ? std::to_string(lower->Key()) : "end")
+              << ", upper "
+              << (upper != map.end() ? std::to_string(upper->Key()) : "end")
+              << ", equal " << (first != last ? "1" : "0") << "\n";
+  }
+
+  int windows[][2] = {{15, 55}, {20, 50}, {-10, 10}, {85, 200}, {50, 20}};
+  for (auto& window: windows) {
+    std::cout << "[" << window[0] << ", " << window[1] << "):";
+    for (auto& node: map.range(window[0], window[1])) {
+      std::cout << " " << node.Key();
+    }
+    std::cout << "\n";
+  }
+
+  const CS280::BSTmap<int, int, CS280::RedBlack>& view = map;
+  int sum = 0;
+  for (const auto& node: view.range(30, 70)) {
+    sum += node.Key();
+  }
+  std::cout << "sum of [30, 70): " << sum << "\n";
+}
+
+// walking backwards, from end() and through reverse iterators
+// expected output - out25
+void test25() {
+  CS280::BSTmap<int, int, CS280::AVL> map;
+  std::cout << "empty: " << (map.rbegin() == map.rend()) << "\n";
+  simple_inserts(map, std::vector<int>{5, 3, 8, 1, 4, 7, 9, 2, 6});
+
+  auto last = --map.end();
+  std::cout << "last " << last->Key() << ", before it "
+            << std::prev(last)->Key() << "\n";
+
+  for (auto it = map.end(); it != map.begin();) {
+    --it;
+    std::cout << it->Key() << " ";
+  }
+  std::cout << "\n";
+
+  map.erase(map.find(9));
+  map.erase(map.find(8));
+  map[10] = 0;
+  for (auto it = map.rbegin(); it != map.rend(); ++it) {
+    std::cout << it->Key() << " ";
+  }
+  std::cout << "\n";
+
+  // latest three
+  const CS280::BSTmap<int, int, CS280::AVL>& view = map;
+  int taken = 0;
+  for (auto it = view.rbegin(); it != view.rend() and taken < 3; ++it) {
+    std::cout << it->Key() << " ";
+    ++taken;
+  }
+  std::cout << "\n";
+
+  auto it = map.find(4);
+  it--;
+  it++;
+  std::cout << "back and forth " << it->Key() << "\n";
+}
+
+// the cached ends follow inserts and erases, used here to evict the oldest
+// expected output - out26
+void test26() {
+  CS280::BSTmap<int, int, CS280::RedBlack> map;
+  std::vector<int> data{50, 30, 70, 20, 40, 60, 80, 10, 90};
+  for (const int& key: data) {
+    map[key] = key;
+    std::cout << "+" << key << " front " << map.front().Key() << " back "
+              << map.back().Key() << "\n";
+  }
+
+  while (map.size() > 2) {
+    int oldest = map.begin()->Key();
+    map.erase(map.begin());
+    if (!map.sanityCheck()) std::cout << "Error\n";
+    std::cout << "-" << oldest << " front " << map.front().Key() << " back "
+              << map.back().Key() << "\n";
+  }
+
+  map.erase(map.find(map.back().Key()));
+  const CS280::BSTmap<int, int, CS280::RedBlack>& view = map;
+  std::cout << "only " << view.front().Key() << " " << view.back().Key()
+            << "\n";
+  map.erase(map.begin());
+  std::cout << "empty " << (map.begin() == map.end()) << "\n";
+}
+
+// end() is the header of its map: empty maps, single nodes and maps moved
+// out of all step to and from it
+// expected output - out27
+void test27() {
+  CS280::BSTmap<int, int, CS280::AVL> map;
+  std::cout << "empty begin == end " << (map.begin() == map.end()) << "\n";
+
+  map[7] = 70;
+  auto it = map.end();
+  --it;
+  std::cout << "single " << it->Key() << ", ++ reaches end "
+            << (++it == map.end()) << "\n";
+
+  map.erase(map.begin());
+  std::cout << "erased begin == end " << (map.begin() == map.end())
+            << (map.sanityCheck() ? "" : " Error") << "\n";
+
+  simple_inserts(map, std::vector<int>{4, 2, 6, 1, 3, 5, 7});
+  CS280::BSTmap<int, int, CS280::AVL> moved(std::move(map));
+  std::cout << "moved out begin == end " << (map.begin() == map.end())
+            << ", moved last " << (--moved.end())->Key() << "\n";
+
+  map[9] = 90;
+  map[8] = 80;
+  for (auto back = map.end(); back != map.begin();) {
+    --back;
+    std::cout << back->Key() << " ";
+  }
+  std::cout << (map.sanityCheck() and moved.sanityCheck() ? "" : "Error")
+            << "\n";
+
+  moved = std::move(map);
+  for (auto& node: moved) {
+    std::cout << node.Key() << " ";
+  }
+  std::cout << "\n";
+}
+
+template<typename Balance>
+using RankedMap = CS280::BSTmap<
+  int,
+  int,
+  Balance,
+  std::less<int>,
+  std::allocator<std::pair<const int, int>>,
+  CS280::SubtreeSize>;
+
+template<typename Map>
+void ranks(const char* name) {
+  Map map;
+  std::vector<int> keys(200);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{28});
+
+  // even keys 0, 2, ..., 398
+  for (const int& key: keys) {
+    map[key * 2] = key;
+  }
+  // drop every fourth one, 0, 8, ..., 392
+  for (const int& key: keys) {
+    if (key % 4 == 0) {
+      map.erase(key * 2);
+    }
+  }
+  bool ok = map.sanityCheck();
+
+  // 150 left, the one at position i is 2 * (i + i / 3 + 1)
+  for (int i = 0; i < 150; ++i) {
+    ok = ok and map.select(i)->Key() == 2 * (i + i / 3 + 1);
+    ok = ok and map.rank(map.select(i)->Key()) == static_cast<usize>(i);
+  }
+
+  std::cout << name << (ok ? "" : " Error") << ": size " << map.size()
+            << ", rank(0) " << map.rank(0) << ", rank(9) " << map.rank(9)
+            << ", rank(1000) " << map.rank(1000) << ", median "
+            << map.select(map.size() / 2)->Key() << ", p90 "
+            << map.select(map.size() * 90 / 100)->Key() << ", select(150) "
+            << (map.select(150) == map.end() ? "end" : "?") << "\n";
+
+  // iterating on from a position walks the rest in order
+  std::cout << "  from 145:";
+  for (auto it = map.select(145); it != map.end(); ++it) {
+    std::cout << " " << it->Key();
+  }
+
+  const Map copy{map};
+  std::cout << "\n  copy " << copy.select(75)->Key() << " "
+            << copy.rank(copy.select(75)->Key()) << "\n";
+}
+
+void test28() {
+  ranks<RankedMap<CS280::Unbalanced>>("unbalanced");
+  ranks<RankedMap<CS280::AVL>>("avl");
+  ranks<RankedMap<CS280::RedBlack>>("red-black");
+}
+
+// sum of the values, say bytes per key
+struct ByteTotal {
+  using value_type = long long;
+
+  value_type identity() const { return 0; }
+
+  value_type leaf(const int&, const int& bytes) const { return bytes; }
+
+  value_type combine(value_type lhs, value_type rhs) const {
+    return lhs + rhs;
+  }
+};
+
+// largest value
+struct MaxValue {
+  using value_type = int;
+
+  value_type identity() const { return std::numeric_limits<int>::min(); }
+
+  value_type leaf(const int&, const int& value) const { return value; }
+
+  value_type combine(value_type lhs, value_type rhs) const {
+    return std::max(lhs, rhs);
+  }
+};
+
+// keys spelled out in order, combine does not commute, and as leaf only
+// reads the key the values stay writable in place
+struct KeyTrail {
+  using value_type = std::string;
+
+  value_type identity() const { return ""; }
+
+  value_type leaf(const int& key) const { return std::to_string(key) + " "; }
+
+  value_type combine(const value_type& lhs, const value_type& rhs) const {
+    return lhs + rhs;
+  }
+};
+
+template<typename Balance, typename Augment>
+using AugmentedMap = CS280::BSTmap<
+  int,
+  int,
+  Balance,
+  std::less<int>,
+  std::allocator<std::pair<const int, int>>,
+  Augment>;
+
+template<typename Map, typename Augment>
+bool matches_scan(Map& map, int lo, int hi) {
+  const Augment augment{};
+  typename Augment::value_type scanned = augment.identity();
+  for (auto& node: map.range(lo, hi)) {
+    if constexpr (CS280::has_key_leaf<Augment, int>::value) {
+      scanned = augment.combine(scanned, augment.leaf(node.Key()));
+    } else {
+      scanned =
+        augment.combine(scanned, augment.leaf(node.Key(), node.Value()));
+    }
+  }
+  return map.aggregate(lo, hi) == scanned;
+}
+
+template<typename Balance>
+void aggregates(const char* name) {
+  AugmentedMap<Balance, ByteTotal> bytes;
+  AugmentedMap<Balance, MaxValue> max;
+  AugmentedMap<Balance, KeyTrail> trail;
+  std::vector<int> keys(100);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{29});
+
+  for (const int& key: keys) {
+    bytes.insert_or_assign(key, key * 3);
+    max.try_emplace(key, (key * 37) % 101);
+    trail[key] = 0;
+  }
+  for (const int& key: keys) {
+    if (key % 3 == 0) {
+      bytes.erase(key);
+      max.erase(key);
+      trail.erase(key);
+    }
+  }
+
+  bool ok = bytes.sanityCheck() and max.sanityCheck() and trail.sanityCheck();
+  for (int lo = -2; lo < 103; lo += 3) {
+    for (int hi = -2; hi < 103; ++hi) {
+      ok = ok and matches_scan<decltype(bytes), ByteTotal>(bytes, lo, hi);
+      ok = ok and matches_scan<decltype(max), MaxValue>(max, lo, hi);
+      ok = ok and matches_scan<decltype(trail), KeyTrail>(trail, lo, hi);
+    }
+  }
+
+  std::cout << name << (ok ? "" : " Error") << ": bytes [0, 100) "
+            << bytes.aggregate(0, 100) << ", [10, 20) "
+            << bytes.aggregate(10, 20) << ", [20, 10) "
+            << bytes.aggregate(20, 10) << ", max [40, 60) "
+            << max.aggregate(40, 60) << "\n";
+  std::cout << "  trail [10, 20) " << trail.aggregate(10, 20) << "\n";
+
+  // values changed after the fact, bytes only through insert_or_assign (its
+  // Value() is const), trail in place as well
+  bytes.insert_or_assign(11, 1000);
+  std::cout << "  assigned " << bytes.aggregate(10, 20);
+  bytes.insert_or_assign(13, 2000);
+  bytes.insert_or_assign(14, 3000);
+  trail[13] = 5;
+  trail.find(14)->Value() = 6;
+  std::cout << ", reassigned " << bytes.aggregate(10, 20)
+            << ", whole copy " << decltype(bytes){bytes}.aggregate(0, 100)
+            << (bytes.sanityCheck() and trail.sanityCheck() ? "" : " Error")
+            << "\n";
+}
+
+void test29() {
+  aggregates<CS280::Unbalanced>("unbalanced");
+  aggregates<CS280::AVL>("avl");
+  aggregates<CS280::RedBlack>("red-black");
+}
+
+// input iterator over a vector of pairs, to build from a single pass range
+struct OnePass {
+  using iterator_category = std::input_iterator_tag;
+  using value_type = std::pair<int, int>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const value_type*;
+  using reference = const value_type&;
+
+  std::vector<value_type>::const_iterator it;
+
+  reference operator*() const { return *it; }
+
+  OnePass& operator++() {
+    ++it;
+    return *this;
+  }
+
+  bool operator!=(const OnePass& rhs) const { return it != rhs.it; }
+
+  bool operator==(const OnePass& rhs) const { return it == rhs.it; }
+};
+
+template<typename Balance>
+void bulk_builds(const char* name) {
+  using Map = CS280::BSTmap<int, int, Balance>;
+  bool ok = true;
+  for (int n = 0; n <= 70; ++n) {
+    std::vector<std::pair<int, int>> sorted;
+    for (int key = 0; key < n; ++key) {
+      sorted.emplace_back(key * 2, key);
+    }
+
+    Map map{sorted.begin(), sorted.end()};
+    ok = ok and map.sanityCheck() and map.size() == static_cast<usize>(n);
+    ok = ok and map.height() == static_cast<usize>(n ? std::log2(n) + 1 : 0);
+
+    int expected = 0;
+    for (auto& node: map) {
+      ok = ok and node.Key() == expected * 2 and node.Value() == expected;
+      expected++;
+    }
+
+    // still a normal tree afterwards
+    map[-1] = 0;
+    map.erase(n);
+    ok = ok and map.sanityCheck();
+  }
+  std::cout << name << (ok ? "" : " Error") << ": sizes 0 to 70\n";
+
+  // keys out of order after the sorted run, and a repeated key
+  const std::vector<std::pair<int, int>> mixed{
+    {1, 1}, {3, 3}, {5, 5}, {7, 7}, {4, 4}, {3, 30}, {0, 0}, {9, 9}
+  };
+  Map map;
+  map[100] = 100;
+  map.assign(mixed.begin(), mixed.end());
+  std::cout << "  assigned " << map.size()
+            << (map.sanityCheck() ? "" : " Error") << ":";
+  for (auto& node: map) {
+    std::cout << " " << node.Key() << "=" << node.Value();
+  }
+
+  // from a single pass range, nothing can be reserved up front
+  std::cout << "\n  one pass:";
+  Map streamed{OnePass{mixed.begin()}, OnePass{mixed.begin() + 4}};
+  for (auto& node: streamed) {
+    std::cout << " " << node.Key();
+  }
+  std::cout << (streamed.sanityCheck() ? "" : " Error") << "\n";
+}
+
+void test30() {
+  bulk_builds<CS280::Unbalanced>("unbalanced");
+  bulk_builds<CS280::AVL>("avl");
+  bulk_builds<CS280::RedBlack>("red-black");
+
+  // the sizes are right from the start
+  std::vector<std::pair<int, int>> sorted;
+  for (int key = 0; key < 1000; ++key) {
+    sorted.emplace_back(key, key);
+  }
+  RankedMap<CS280::RedBlack> ranked{sorted.begin(), sorted.end()};
+  std::cout << "ranked " << ranked.select(500)->Key() << " "
+            << ranked.rank(250) << (ranked.sanityCheck() ? "" : " Error")
+            << "\n";
+}
+
+template<typename Balance>
+void batches(const char* name) {
+  CS280::BSTmap<int, int, Balance> map;
+  const std::vector<std::pair<int, int>> first{
+    {8, 1}, {2, 1}, {6, 1}, {2, 2}, {4, 1}, {0, 1}
+  };
+  const std::vector<std::pair<int, int>> second{
+    {5, 2}, {4, 2}, {3, 2}, {9, 2}, {1, 2}, {7, 2}, {8, 2}
+  };
+  const usize inserted = map.insert_batch(first);
+  std::cout << name << ": inserted " << inserted << " then "
+            << map.insert_batch(second) << ", size " << map.size()
+            << (map.sanityCheck() ? "" : " Error") << "\n ";
+  for (auto& node: map) {
+    std::cout << " " << node.Key() << "=" << node.Value();
+  }
+
+  const std::vector<int> keys{7, -1, 3, 10, 3, 0, 9};
+  std::vector<typename CS280::BSTmap<int, int, Balance>::iterator> found;
+  map.find_batch(keys, std::back_inserter(found));
+  std::cout << "\n  found";
+  for (auto& it: found) {
+    if (it == map.end()) {
+      std::cout << " -";
+    } else {
+      std::cout << " " << it->Key();
+    }
+  }
+
+  // random batches against std::map
+  std::mt19937 rng{31};
+  std::map<int, int> reference;
+  for (auto& node: map) {
+    reference[node.Key()] = node.Value();
+  }
+  bool ok = true;
+  for (int round = 0; round < 50; ++round) {
+    std::vector<std::pair<int, int>> batch(200);
+    for (std::pair<int, int>& pair: batch) {
+      pair = {static_cast<int>(rng() % 5000), round};
+    }
+
+    usize expected = 0;
+    for (const std::pair<int, int>& pair: batch) {
+      expected += reference.insert(pair).second ? 1 : 0;
+    }
+    const usize inserted = map.insert_batch(batch);
+    ok = ok and inserted == expected and map.sanityCheck();
+
+    std::vector<int> probe(100);
+    for (int& key: probe) {
+      key = static_cast<int>(rng() % 5000);
+    }
+    std::vector<typename CS280::BSTmap<int, int, Balance>::const_iterator> hits;
+    const auto& view = map;
+    view.find_batch(probe, std::back_inserter(hits));
+    for (usize i = 0; i < probe.size(); ++i) {
+      auto ref = reference.find(probe[i]);
+      ok = ok and (hits[i] == view.end()) == (ref == reference.end());
+      ok = ok and (ref == reference.end() or hits[i]->Key() == ref->first);
+    }
+  }
+  std::cout << "\n  random batches" << (ok ? "" : " Error") << ", size "
+            << map.size() << "\n";
+}
+
+void test31() {
+  batches<CS280::Unbalanced>("unbalanced");
+  batches<CS280::AVL>("avl");
+  batches<CS280::RedBlack>("red-black");
+}
+
+template<typename Map>
+void print_keys(const char* label, Map& map) {
+  std::cout << "  " << label << " " << map.size()
+            << (map.sanityCheck() ? "" : " Error") << ":";
+  for (auto& node: map) {
+    std::cout << " " << node.Key() << "=" << node.Value();
+  }
+  std::cout << "\n";
+}
+
+template<typename Balance>
+void set_operations(const char* name) {
+  using Map = CS280::BSTmap<int, int, Balance>;
+  std::vector<std::pair<int, int>> sorted;
+  for (int key = 0; key < 12; ++key) {
+    sorted.emplace_back(key, key);
+  }
+
+  std::cout << name << "\n";
+  Map map{sorted.begin(), sorted.end()};
+  auto* const five = &*map.find(5);
+  auto* const nine = &*map.find(9);
+
+  auto [lower, upper] = map.split(7);
+  print_keys("lower", lower);
+  print_keys("upper", upper);
+  std::cout << "  left behind " << map.size()
+            << (map.sanityCheck() ? "" : " Error") << ", same nodes "
+            << (&*lower.find(5) == five and &*upper.find(9) == nine) << "\n";
+
+  auto [none, all] = upper.split(-1);
+  auto [everything, nothing] = all.split(100);
+  std::cout << "  edges " << none.size() << " " << everything.size() << " "
+            << nothing.size() << "\n";
+
+  Map joined = Map::join(std::move(lower), std::move(everything));
+  print_keys("joined", joined);
+  std::cout << "  same nodes "
+            << (&*joined.find(5) == five and &*joined.find(9) == nine)
+            << ", sources " << lower.size() << " " << everything.size()
+            << "\n";
+
+  // overlapping ranges fall back to a merge, the left side wins
+  Map left;
+  Map right;
+  for (int key = 0; key < 6; ++key) {
+    left[key * 2] = 1;
+    right[key * 3] = 2;
+  }
+  Map overlap = Map::join(std::move(left), std::move(right));
+  print_keys("overlap", overlap);
+
+  // merge leaves the keys it already has in the other map
+  Map evens;
+  Map odds;
+  for (int key = 0; key < 8; ++key) {
+    evens[key * 2] = 1;
+    odds[key * 2 + 1] = 2;
+  }
+  odds[4] = 2;
+  auto* const three = &*odds.find(3);
+  evens.merge(odds);
+  print_keys("merged", evens);
+  print_keys("kept", odds);
+  std::cout << "  same node " << (&*evens.find(3) == three) << "\n";
+
+  // a handful of nodes into a big map goes one node at a time
+  Map big{sorted.begin(), sorted.end()};
+  for (int key = 100; key < 400; ++key) {
+    big[key] = key;
+  }
+  Map few;
+  few[50] = 5;
+  few[3] = 5;
+  few[-4] = 5;
+  big.merge(std::move(few));
+  std::cout << "  small merge " << big.size() << " " << big.find(50)->Value()
+            << " " << big.find(3)->Value() << ", left " << few.size()
+            << (big.sanityCheck() and few.sanityCheck() ? "" : " Error")
+            << "\n";
+}
+
+void test32() {
+  set_operations<CS280::Unbalanced>("unbalanced");
+  set_operations<CS280::AVL>("avl");
+  set_operations<CS280::RedBlack>("red-black");
+
+  // separate pools cannot take each other's nodes, the values move instead
+  using Pool = CS280::PoolAllocator<std::pair<const int, int>>;
+  using PoolMap = CS280::BSTmap<int, int, CS280::AVL, std::less<int>, Pool>;
+  PoolMap first;
+  PoolMap second;
+  for (int key = 0; key < 5; ++key) {
+    first[key] = 1;
+    second[key + 3] = 2;
+  }
+  first.merge(second);
+  print_keys("pools", first);
+  print_keys("pools kept", second);
+
+  // the sizes come out right for rank and select
+  std::vector<std::pair<int, int>> sorted;
+  for (int key = 0; key < 100; ++key) {
+    sorted.emplace_back(key, key);
+  }
+  RankedMap<CS280::RedBlack> ranked{sorted.begin(), sorted.end()};
+  auto [low, high] = ranked.split(30);
+  std::cout << "ranked " << low.select(29)->Key() << " "
+            << high.select(0)->Key() << " " << high.rank(50);
+  auto whole = RankedMap<CS280::RedBlack>::join(std::move(low), std::move(high));
+  std::cout << " " << whole.select(50)->Key()
+            << (whole.sanityCheck() ? "" : " Error") << "\n";
+}
+
+// the index based map against the same operations, iterators are slots and
+// survive the node vector growing
+// expected output - out33
+void test33() {
+  using Map = CS280::CompactBSTmap<int, int>;
+  std::cout << "node " << sizeof(Map::Node) << " bytes\n";
+
+  Map map;
+  simple_inserts(map, std::vector<int>{5, 3, 8, 1, 4, 7, 9, 2, 6});
+  auto four = map.find(4);
+  for (int key = 10; key < 1000; ++key) {
+    map[key] = key;
+  }
+  std::cout << "after growing " << four->Key() << " " << four->Value()
+            << ", size " << map.size() << "\n";
+
+  for (int key = 10; key < 1000; ++key) {
+    map.erase(key);
+  }
+  map.erase(map.find(5));
+  std::cout << "erased " << map.erase(5) << " " << map.erase(1) << ":";
+  for (auto& node: map) {
+    std::cout << " " << node.Key();
+  }
+  std::cout << "\n  backwards:";
+  for (auto it = map.rbegin(); it != map.rend(); ++it) {
+    std::cout << " " << it->Key();
+  }
+  const Map& view = map;
+  std::cout << "\n  bounds " << view.lower_bound(5)->Key() << " "
+            << view.upper_bound(6)->Key() << " "
+            << (view.upper_bound(9) == view.end()) << ", contains "
+            << view.contains(3) << view.contains(5) << "\n";
+
+  // against std::map under random inserts and erases
+  std::map<int, int> reference;
+  for (auto& node: map) {
+    reference[node.Key()] = node.Value();
+  }
+  std::mt19937 rng{280};
+  bool ok = true;
+  for (int i = 0; i < 20000; ++i) {
+    const int key = static_cast<int>(rng() % 500);
+    if (rng() % 3) {
+      map[key] = i;
+      reference[key] = i;
+    } else {
+      ok = ok and map.erase(key) == reference.erase(key);
+    }
+    ok = ok and map.size() == reference.size();
+  }
+  ok = ok and map.sanityCheck();
+  ok = ok and std::equal(
+    map.begin(), map.end(), reference.begin(), reference.end(),
+    [](const Map::Node& node, const std::pair<const int, int>& pair) {
+      return node.Key() == pair.first and node.Value() == pair.second;
+    }
+  );
+
+  Map copy{map};
+  Map moved{std::move(map)};
+  copy.erase(copy.begin());
+  std::cout << "random " << (ok ? "matches" : "Error") << ", copy "
+            << copy.size() << ", moved " << moved.size() << ", source "
+            << map.size()
+            << (copy.sanityCheck() and moved.sanityCheck() and map.empty()
+                  ? ""
+                  : " Error")
+            << "\n";
+}
+
+// a frozen snapshot answers like the map it came from, and stays as it was
+// when the map moves on
+// expected output - out34
+void test34() {
+  CS280::BSTmap<int, std::string, CS280::RedBlack> map;
+  for (int key = 1; key <= 10; ++key) {
+    map[key * 10] = std::to_string(key);
+  }
+  const auto frozen = map.freeze();
+  map.erase(50);
+  map[55] = "new";
+
+  std::cout << "frozen " << frozen.size() << ":";
+  for (auto& node: frozen) {
+    std::cout << " " << node.Key() << "=" << node.Value();
+  }
+  std::cout << "\n  backwards:";
+  for (auto it = frozen.rbegin(); it != frozen.rend(); ++it) {
+    std::cout << " " << it->Key();
+  }
+  std::cout << "\n  find 50 " << frozen.find(50)->Value() << ", 55 "
+            << (frozen.find(55) == frozen.end()) << ", bounds "
+            << frozen.lower_bound(55)->Key() << " "
+            << frozen.upper_bound(60)->Key() << " "
+            << frozen.lower_bound(0)->Key() << " "
+            << (frozen.upper_bound(100) == frozen.end()) << "\n";
+
+  // every size up to a few full trees, against the live map
+  bool ok = true;
+  CS280::BSTmap<int, int, CS280::AVL> live;
+  for (int n = 0; n < 70; ++n) {
+    const auto snapshot = live.freeze();
+    ok = ok and snapshot.sanityCheck() and snapshot.size() == live.size();
+    for (int key = -1; key <= 3 * n + 1; ++key) {
+      auto bound = snapshot.lower_bound(key);
+      auto expected = live.lower_bound(key);
+      ok = ok and (bound == snapshot.end()) == (expected == live.end());
+      ok = ok and (bound == snapshot.end() or bound->Key() == expected->Key());
+      ok = ok and snapshot.contains(key) == live.contains(key);
+    }
+    live[3 * n] = n;
+  }
+  const CS280::FrozenBSTmap<int, int> empty;
+  std::cout << "sizes " << (ok ? "match" : "Error") << ", empty "
+            << (empty.find(1) == empty.end()) << empty.empty() << "\n";
+}
+
+// breadth first snapshots: int keys go through the vector path, strings
+// through the plain descent, both answer like the map they came from
+// expected output - out35
+void test35() {
+  CS280::BSTmap<std::string, int, CS280::AVL> words;
+  for (const char* word: {"kiwi", "fig", "apple", "lime", "date", "pear"}) {
+    words[word] = static_cast<int>(words.size());
+  }
+  const auto frozen = words.freeze_eytzinger();
+  std::cout << "words " << frozen.size() << ":";
+  for (auto& node: frozen) {
+    std::cout << " " << node.Key() << "=" << node.Value();
+  }
+  std::cout << "\n  backwards:";
+  for (auto it = frozen.rbegin(); it != frozen.rend(); ++it) {
+    std::cout << " " << it->Key();
+  }
+  std::cout << "\n  find lime " << frozen.find("lime")->Value() << ", plum "
+            << (frozen.find("plum") == frozen.end()) << ", bounds "
+            << frozen.lower_bound("grape")->Key() << " "
+            << frozen.upper_bound("kiwi")->Key() << " "
+            << (frozen.upper_bound("pear") == frozen.end()) << "\n";
+
+  bool ok = true;
+  CS280::BSTmap<int, int, CS280::RedBlack> live;
+  for (int n = 0; n < 200; ++n) {
+    const auto snapshot = live.freeze_eytzinger();
+    ok = ok and snapshot.sanityCheck() and snapshot.size() == live.size();
+    for (int key = -1; key <= 5 * n + 1; ++key) {
+      auto bound = snapshot.upper_bound(key);
+      auto expected = live.upper_bound(key);
+      ok = ok and (bound == snapshot.end()) == (expected == live.end());
+      ok = ok and (bound == snapshot.end() or bound->Key() == expected->Key());
+      ok = ok and snapshot.contains(key) == live.contains(key);
+    }
+    live[5 * n] = n;
+  }
+  std::cout << "sizes " << (ok ? "match" : "Error") << "\n";
+}
+
+// the B+ tree under the same operations, with nodes small enough for a few
+// dozen keys to make three levels (sorted inserts fill every leaf), then
+// string keys against std::map
+// expected output - out36
+void test36() {
+  using Map = CS280::BPlusTreeMap<int, std::string, 4>;
+  Map map;
+  for (int key = 1; key <= 30; ++key) {
+    map[key * 10] = std::to_string(key);
+  }
+  std::cout << "size " << map.size() << ", depth " << map.depth() << "\n";
+
+  for (int key = 40; key <= 250; key += 10) {
+    map.erase(key);
+  }
+  map.erase(map.find(10));
+  std::cout << "erased " << map.erase(10) << " " << map.erase(20)
+            << ", depth " << map.depth() << ":";
+  for (auto& node: map) {
+    std::cout << " " << node.Key() << "=" << node.Value();
+  }
+  std::cout << "\n  backwards:";
+  for (auto it = map.rbegin(); it != map.rend(); ++it) {
+    std::cout << " " << it->Key();
+  }
+  const Map& view = map;
+  std::cout << "\n  bounds " << view.lower_bound(35)->Key() << " "
+            << view.upper_bound(260)->Key() << " "
+            << (view.upper_bound(300) == view.end()) << ", contains "
+            << view.contains(30) << view.contains(40) << "\n";
+
+  using Words = CS280::BPlusTreeMap<std::string, int, 5>;
+  Words words;
+  std::map<std::string, int> reference;
+  std::mt19937 rng{280};
+  bool ok = true;
+  for (int i = 0; i < 30000; ++i) {
+    const std::string key = "w" + std::to_string(rng() % 700);
+    if (rng() % 3) {
+      words[key] = i;
+      reference[key] = i;
+    } else {
+      ok = ok and words.erase(key) == reference.erase(key);
+    }
+    ok = ok and words.size() == reference.size();
+  }
+  ok = ok and words.sanityCheck();
+  ok = ok and std::equal(
+    words.begin(), words.end(), reference.begin(), reference.end(),
+    [](
+      const Words::Node& node,
+      const std::pair<const std::string, int>& pair
+    ) {
+      return node.Key() == pair.first and node.Value() == pair.second;
+    }
+  );
+
+  Words copy{words};
+  Words moved{std::move(words)};
+  copy.erase(copy.begin());
+  std::cout << "random " << (ok ? "matches" : "Error") << ", copy "
+            << copy.size() << ", moved " << moved.size() << ", source "
+            << words.size()
+            << (copy.sanityCheck() and moved.sanityCheck() and words.empty()
+                  ? ""
+                  : " Error")
+            << "\n";
+}
+
+// splaying: ascending inserts leave a path, a find at its bottom brings the
+// key up to the root and about halves the depth, finds of the root rotate
+// nothing and a miss brings up the last node it looked at
+// expected output - out37
+void test37() {
+  CS280::BSTmap<int, int, CS280::Splay> map;
+  simple_inserts(map, std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8});
+  std::cout << "height " << map.height() << "\n";
+
+  map.find(1);
+  std::cout << map << "height " << map.height() << "\n";
+
+  map.reset_statistics();
+  for (int i = 0; i < 10; ++i) {
+    map.find(1);
+  }
+  std::cout << "10 more finds, rotations " << map.statistics().rotations
+            << "\n";
+
+  map[6] += 1;
+  map.find(100);
+  std::cout << map << "in order:";
+  for (auto& node: map) {
+    std::cout << " " << node.Key() << "=" << node.Value();
+  }
+  std::cout << (map.sanityCheck() ? "" : " Error") << "\n";
+}
+
+void (*pTests[])(void) = {
+  test0,
+  test1,
+  test2,
+  test3,
+  test4,
+  test5,
+  test6,
+  test7,
+  test8,
+  test9,
+  test10,
+  test11,
+  test12,
+  test13,
+  test14,
+  test15,
+  test16,
+  test17,
+  test18,
+  test19,
+  test20,
+  test21,
+  test22,
+  test23,
+  test24,
+  test25,
+  test26,
+  test27,
+  test28,
+  test29,
+  test30,
+  test31,
+  test32,
+  test33,
+  test34,
+  test35,
+  test36,
+  test37,
+};
+
+////////////////////////////////////////////////
+// benchmarks, run as "driver bench <number> [size]"
+// size 0 picks the default for the benchmark
+
+// wall time of f in milliseconds
+template<typename F>
+double time_ms(F&& f) {
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// inserts 0..N-1 in ascending order
+template<typename Map>
+double ascending_inserts(int N) {
+  Map map;
+  return time_ms([&map, N]() {
+    for (int key = 0; key < N; ++key) {
+      map[key] = key;
+    }
+  });
+}
+
+// ascending-key insert throughput, plain tree vs AVL
+void bench0(int N) {
+  N = N ? N : 20000;
+  double plain = ascending_inserts<CS280::BSTmap<int, int>>(N);
+  double avl = ascending_inserts<CS280::BSTmap<int, int, CS280::AVL>>(N);
+  std::cout << "ascending inserts, N = " << N << "\n";
+  std::cout << "  unbalanced " << plain << " ms\n";
+  std::cout << "  AVL        " << avl << " ms\n";
+}
+
+// N random operations on keys from [0, N), each one an insert, erase or
+// find picked with the given percentages (finds get the rest)
+template<typename Map>
+double mixed_workload(int N, int insert_pct, int erase_pct) {
+  std::mt19937 gen(280);
+  std::uniform_int_distribution<int> key_dis(0, N - 1);
+  std::uniform_int_distribution<int> op_dis(0, 99);
+  std::vector<std::pair<int, int>> ops(N);
+  for (std::pair<int, int>& op: ops) {
+    op = {op_dis(gen), key_dis(gen)};
+  }
+
+  Map map;
+  int found = 0;
+  double ms = time_ms([&]() {
+    for (const std::pair<int, int>& op: ops) {
+      if (op.first < insert_pct) {
+        map[op.second] = op.second;
+      } else if (op.first < insert_pct + erase_pct) {
+        map.erase(map.find(op.second));
+      } else {
+        found += map.find(op.second) != map.end();
+      }
+    }
+  });
+  // keep the finds from being optimized away
+  if (found < 0) std::cout << found;
+  return ms;
+}
+
+// insert / erase / find mixes across the balancing policies
+void bench1(int N) {
+  N = N ? N : 1000000;
+  const int mixes[][2] = {{80, 10}, {45, 45}, {10, 10}};
+  std::cout << "random mixed operations, N = " << N << "\n";
+  for (const int* mix: mixes) {
+    std::cout << "  " << mix[0] << "% insert " << mix[1] << "% erase "
+              << 100 - mix[0] - mix[1] << "% find\n";
+    std::cout << "    unbalanced "
+              << mixed_workload<CS280::BSTmap<int, int>>(N, mix[0], mix[1])
+              << " ms\n";
+    std::cout << "    AVL        "
+              << mixed_workload<CS280::BSTmap<int, int, CS280::AVL>>(
+                   N,
+                   mix[0],
+                   mix[1]
+                 )
+              << " ms\n";
+    std::cout << "    red-black  "
+              << mixed_workload<CS280::BSTmap<int, int, CS280::RedBlack>>(
+                   N,
+                   mix[0],
+                   mix[1]
+                 )
+              << " ms\n";
+  }
+}
+
+// inserts the keys and reports how many nodes the upward height pass
+// touched per insert; a full walk to the root touches up to 'height' nodes
+template<typename Map>
+void report_touched(const char* name, const std::vector<int>& keys) {
+  Map map;
+  double ms = time_ms([&map, &keys]() {
+    for (const int& key: keys) {
+      map[key] = key;
+    }
+  });
+  const typename Map::Stats& stats = map.statistics();
+  std::cout << "    " << name << " touched/insert "
+            << static_cast<double>(stats.height_updates) / keys.size()
+            << ", rotations/insert "
+            << static_cast<double>(stats.rotations) / keys.size()
+            << ", height " << map.height() << ", " << ms << " ms\n";
+}
+
+// nodes touched per insert by the height maintenance pass
+void bench2(int N) {
+  N = N ? N : 1000000;
+  std::vector<int> keys(N);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+
+  std::cout << "random inserts, N = " << N << "\n";
+  report_touched<CS280::BSTmap<int, int>>("unbalanced", keys);
+  report_touched<CS280::BSTmap<int, int, CS280::AVL>>("AVL       ", keys);
+  report_touched<CS280::BSTmap<int, int, CS280::RedBlack>>("red-black ", keys);
+
+  std::sort(keys.begin(), keys.end());
+  std::cout << "ascending inserts, N = " << N << "\n";
+  report_touched<CS280::BSTmap<int, int, CS280::AVL>>("AVL       ", keys);
+  report_touched<CS280::BSTmap<int, int, CS280::RedBlack>>("red-black ", keys);
+}
+
+// random inserts and erases on keys from [0, N / 10), printing the tree
+// height every N / 10 operations
+template<typename Map>
+void height_over_time(const char* name, int N) {
+  const int every = std::max(1, N / 10);
+  std::mt19937 gen(280);
+  std::uniform_int_distribution<int> key_dis(0, every);
+  Map map;
+  std::cout << "  " << name;
+  double ms = time_ms([&]() {
+    for (int i = 1; i <= N; ++i) {
+      int key = key_dis(gen);
+      if (gen() % 2) {
+        map[key] = i;
+      } else {
+        map.erase(map.find(key));
+      }
+      if (i % every == 0) {
+        std::cout << " " << map.height();
+      }
+    }
+  });
+  std::cout << " (size " << map.size() << ", " << ms << " ms)\n";
+}
+
+// tree height under a long mixed insert / erase workload
+void bench3(int N) {
+  N = N ? N : 4000000;
+  std::cout << "height every " << std::max(1, N / 10) << " of " << N
+            << " mixed operations\n";
+  height_over_time<CS280::BSTmap<int, int>>("unbalanced", N);
+  height_over_time<CS280::BSTmap<int, int, CS280::AVL>>("AVL       ", N);
+  height_over_time<CS280::BSTmap<int, int, CS280::RedBlack>>("red-black ", N);
+}
+
+// fills the map with N random keys, then erases one key and inserts
+// another N * 4 times
+template<typename Map>
+double churn(int N) {
+  std::mt19937 gen(280);
+  std::uniform_int_distribution<int> key_dis(0, N * 4);
+  Map map;
+  return time_ms([&]() {
+    for (int i = 0; i < N; ++i) {
+      map[key_dis(gen)] = i;
+    }
+    for (int i = 0; i < N * 4; ++i) {
+      map.erase(map.find(key_dis(gen)));
+      map[key_dis(gen)] = i;
+    }
+  });
+}
+
+// insert / erase churn, global heap vs pool allocator
+void bench4(int N) {
+  N = N ? N : 200000;
+  typedef CS280::PoolAllocator<std::pair<const int, int>> Pool;
+  std::cout << "insert/erase churn, N = " << N << "\n";
+  std::cout << "  AVL, std::allocator       "
+            << churn<CS280::BSTmap<int, int, CS280::AVL>>(N) << " ms\n";
+  std::cout << "  AVL, PoolAllocator        "
+            << churn<CS280::BSTmap<int, int, CS280::AVL, std::less<int>, Pool>>(
+                 N
+               )
+            << " ms\n";
+  std::cout << "  red-black, std::allocator "
+            << churn<CS280::BSTmap<int, int, CS280::RedBlack>>(N) << " ms\n";
+  std::cout << "  red-black, PoolAllocator  "
+            << churn<CS280::BSTmap<
+                 int,
+                 int,
+                 CS280::RedBlack,
+                 std::less<int>,
+                 Pool>>(N)
+            << " ms\n";
+}
+
+// builds an N node map from ascending keys and times clear()
+template<typename Map>
+double teardown(int N) {
+  Map map;
+  for (int key = 0; key < N; ++key) {
+    map[key] = key;
+  }
+  return time_ms([&map]() { map.clear(); });
+}
+
+// teardown of large maps
+void bench5(int N) {
+  N = N ? N : 10000000;
+  typedef CS280::PoolAllocator<std::pair<const int, int>> Pool;
+  std::cout << "clear(), N = " << N << "\n";
+  std::cout << "  AVL, std::allocator "
+            << teardown<CS280::BSTmap<int, int, CS280::AVL>>(N) << " ms\n";
+  std::cout << "  AVL, PoolAllocator  "
+            << teardown<
+                 CS280::BSTmap<int, int, CS280::AVL, std::less<int>, Pool>>(N)
+            << " ms\n";
+}
+
+// copy construction and copy assignment of an N entry map
+template<typename Map>
+void copies(const char* name, int N) {
+  std::vector<int> keys(N);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+  Map map;
+  for (const int& key: keys) {
+    map[key] = key;
+  }
+
+  Map target;
+  target[0] = 0;
+  double construct = time_ms([&map]() { Map copy(map); });
+  double assign = time_ms([&map, &target]() { target = map; });
+  std::cout << "  " << name << " copy ctor " << construct << " ms, assign "
+            << assign << " ms\n";
+}
+
+// snapshotting maps
+void bench6(int N) {
+  N = N ? N : 1000000;
+  typedef CS280::PoolAllocator<std::pair<const int, int>> Pool;
+  std::cout << "copies, N = " << N << " (copy ctor includes teardown)\n";
+  copies<CS280::BSTmap<int, int, CS280::AVL>>("AVL, std::allocator", N);
+  copies<CS280::BSTmap<int, int, CS280::AVL, std::less<int>, Pool>>(
+    "AVL, PoolAllocator ", N
+  );
+}
+
+// comparator calls per hit and per miss over N string keys sharing a long
+// prefix, the way expensive keys look
+template<typename Map>
+void comparisons(const char* name, int N) {
+  const std::string prefix(64, '#');
+  std::vector<std::string> keys(N);
+  for (int i = 0; i < N; ++i) {
+    keys[i] = prefix + std::to_string(i * 2);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+
+  usize calls = 0;
+  Map map(CountingLess<std::string>{&calls});
+  for (const std::string& key: keys) {
+    map[key] = 0;
+  }
+
+  std::vector<std::string> misses(N);
+  for (int i = 0; i < N; ++i) {
+    misses[i] = prefix + std::to_string(i * 2 + 1);
+  }
+  std::shuffle(misses.begin(), misses.end(), std::mt19937{281});
+
+  usize found = 0;
+  calls = 0;
+  double hit_ms = time_ms([&]() {
+    for (const std::string& key: keys) {
+      found += map.find(key) != map.end();
+    }
+  });
+  usize hit_calls = calls;
+
+  calls = 0;
+  double miss_ms = time_ms([&]() {
+    for (const std::string& key: misses) {
+      found += map.find(key) != map.end();
+    }
+  });
+
+  std::cout << "  " << name << " hit "
+            << static_cast<double>(hit_calls) / N << " compares, " << hit_ms
+            << " ms; miss " << static_cast<double>(calls) / N
+            << " compares, " << miss_ms << " ms"
+            << (found == static_cast<usize>(N) ? "" : " (wrong)") << "\n";
+}
+
+// comparator calls per lookup
+void bench7(int N) {
+  N = N ? N : 200000;
+  typedef CountingLess<std::string> Less;
+  std::cout << "comparisons per find, N = " << N << " (log2 N = "
+            << std::log2(N) << ")\n";
+  comparisons<CS280::BSTmap<std::string, int, CS280::Unbalanced, Less>>(
+    "unbalanced", N
+  );
+  comparisons<CS280::BSTmap<std::string, int, CS280::AVL, Less>>(
+    "AVL       ", N
+  );
+  comparisons<CS280::BSTmap<std::string, int, CS280::RedBlack, Less>>(
+    "red-black ", N
+  );
+}
+
+// random hits and random misses on an N key map, the keys are the even
+// numbers so every odd number misses
+template<typename Map>
+void lookups(const char* name, int N) {
+  std::vector<int> keys(N);
+  for (int i = 0; i < N; ++i) {
+    keys[i] = i * 2;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+
+  Map map;
+  for (const int& key: keys) {
+    map[key] = key;
+  }
+
+  std::vector<int> misses(N);
+  for (int i = 0; i < N; ++i) {
+    misses[i] = keys[i] + 1;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{281});
+
+  usize found = 0;
+  double hit_ms = time_ms([&]() {
+    for (const int& key: keys) {
+      found += map.find(key) != map.end();
+    }
+  });
+  double miss_ms = time_ms([&]() {
+    for (const int& key: misses) {
+      found += map.find(key) != map.end();
+    }
+  });
+
+  std::cout << "  " << name << " hits " << hit_ms * 1e6 / N << " ns, misses "
+            << miss_ms * 1e6 / N << " ns"
+            << (found == static_cast<usize>(N) ? "" : " (wrong)") << "\n";
+}
+
+// find on random keys, per lookup
+void bench8(int N) {
+  N = N ? N : 1000000;
+  std::cout << "random lookups, N = " << N << "\n";
+  lookups<CS280::BSTmap<int, int>>("unbalanced", N);
+  lookups<CS280::BSTmap<int, int, CS280::AVL>>("AVL       ", N);
+  lookups<CS280::BSTmap<int, int, CS280::RedBlack>>("red-black ", N);
+}
+
+// windowed scans of 'width' consecutive keys, through range() and by
+// walking from begin() to the window
+void bench9(int N) {
+  N = N ? N : 1000000;
+  const int width = std::min(100, N);
+  const int windows = 2000;
+  CS280::BSTmap<int, int, CS280::AVL> map;
+  for (int key = 0; key < N; ++key) {
+    map[key] = key;
+  }
+
+  std::mt19937 rng{280};
+  std::vector<int> starts(windows);
+  for (int& start: starts) {
+    start = static_cast<int>(rng() % static_cast<unsigned>(N - width + 1));
+  }
+
+  long long ranged = 0;
+  double range_ms = time_ms([&]() {
+    for (const int& start: starts) {
+      for (auto& node: map.range(start, start + width)) {
+        ranged += node.Value();
+      }
+    }
+  });
+
+  long long walked = 0;
+  double walk_ms = time_ms([&]() {
+    for (const int& start: starts) {
+      for (auto it = map.begin(); it != map.end(); ++it) {
+        if (it->Key() >= start + width) {
+          break;
+        }
+        if (it->Key() >= start) {
+          walked += it->Value();
+        }
+      }
+    }
+  });
+
+  std::cout << windows << " windows of " << width << " keys, N = " << N
+            << "\n";
+  std::cout << "  range()          " << range_ms << " ms\n";
+  std::cout << "  walk from begin  " << walk_ms << " ms"
+            << (ranged == walked ? "" : " (sums differ)") << "\n";
+}
+
+// the last 'latest' keys, newest first: walking back from end() against
+// collecting every key into a vector and reversing it
+void bench10(int N) {
+  N = N ? N : 1000000;
+  const int latest = std::min(100, N);
+  const int rounds = 20;
+  CS280::BSTmap<int, int, CS280::RedBlack> map;
+  for (int key = 0; key < N; ++key) {
+    map[key] = key;
+  }
+
+  long long backward = 0;
+  double reverse_ms = time_ms([&]() {
+    for (int round = 0; round < rounds; ++round) {
+      int taken = 0;
+      for (auto it = map.rbegin(); it != map.rend() and taken < latest; ++it) {
+        backward += it->Key();
+        ++taken;
+      }
+    }
+  });
+
+  long long collected = 0;
+  double collect_ms = time_ms([&]() {
+    for (int round = 0; round < rounds; ++round) {
+      std::vector<int> keys;
+      for (auto it = map.begin(); it != map.end(); ++it) {
+        keys.push_back(it->Key());
+      }
+      std::reverse(keys.begin(), keys.end());
+      for (int i = 0; i < latest; ++i) {
+        collected += keys[i];
+      }
+    }
+  });
+
+  std::cout << "latest " << latest << " of N = " << N << ", " << rounds
+            << " rounds\n";
+  std::cout << "  reverse iterator    " << reverse_ms << " ms\n";
+  std::cout << "  collect and reverse " << collect_ms << " ms"
+            << (backward == collected ? "" : " (sums differ)") << "\n";
+}
+
+// sliding window of N keys: every step inserts a new newest key and evicts
+// the oldest, found through begin() or by a descent from the root
+void bench11(int N) {
+  N = N ? N : 100000;
+  const int steps = 1000000;
+  CS280::BSTmap<int, int, CS280::AVL> map;
+  for (int key = 0; key < N; ++key) {
+    map[key] = key;
+  }
+
+  double evict_ms = time_ms([&]() {
+    for (int step = 0; step < steps; ++step) {
+      map[N + step] = step;
+      map.erase(map.begin());
+    }
+  });
+
+  // the same window again, reaching the oldest by a descent
+  double descent_ms = time_ms([&]() {
+    for (int step = 0; step < steps; ++step) {
+      map[N + steps + step] = step;
+      map.erase(map.lower_bound(0));
+    }
+  });
+
+  std::cout << "window of N = " << N << ", " << steps << " steps\n";
+  std::cout << "  evict through begin()       " << evict_ms << " ms\n";
+  std::cout << "  evict through lower_bound() " << descent_ms << " ms\n";
+}
+
+// full in-order walks, forwards and backwards, over N nodes inserted in
+// random order
+void bench12(int N) {
+  N = N ? N : 10000000;
+  std::vector<int> keys(N);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+  CS280::BSTmap<int, int, CS280::RedBlack> map;
+  for (const int& key: keys) {
+    map[key] = key;
+  }
+
+  long long forward = 0;
+  double forward_ms = time_ms([&]() {
+    for (auto it = map.begin(); it != map.end(); ++it) {
+      forward += it->Value();
+    }
+  });
+
+  long long backward = 0;
+  double backward_ms = time_ms([&]() {
+    for (auto it = map.end(); it != map.begin();) {
+      --it;
+      backward += it->Value();
+    }
+  });
+
+  std::cout << "in-order traversal, N = " << N << "\n";
+  std::cout << "  forward  " << forward_ms << " ms, "
+            << forward_ms * 1e6 / N << " ns per step\n";
+  std::cout << "  backward " << backward_ms << " ms, "
+            << backward_ms * 1e6 / N << " ns per step"
+            << (forward == backward ? "" : " (sums differ)") << "\n";
+}
+
+// percentiles of N random keys, by select on a size augmented tree and by
+// walking from begin() (only for a few of them, each walk is O(n)). The
+// inserts are timed against a plain tree to show what the sizes cost
+void bench13(int N) {
+  N = N ? N : 1000000;
+  const int queries = 100000;
+  const int walks = 20;
+  std::vector<int> keys(N);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{13});
+
+  CS280::BSTmap<int, int, CS280::AVL> plain;
+  double plain_ms = time_ms([&]() {
+    for (const int& key: keys) {
+      plain[key] = key;
+    }
+  });
+
+  RankedMap<CS280::AVL> map;
+  double ranked_ms = time_ms([&]() {
+    for (const int& key: keys) {
+      map[key] = key;
+    }
+  });
+
+  std::mt19937 rng{130};
+  std::vector<usize> positions(queries);
+  for (usize& position: positions) {
+    position = rng() % static_cast<unsigned>(N);
+  }
+
+  long long selected = 0;
+  double select_ms = time_ms([&]() {
+    for (const usize& position: positions) {
+      selected += map.select(position)->Key();
+    }
+  });
+
+  long long walked = 0;
+  double walk_ms = time_ms([&]() {
+    for (int i = 0; i < walks; ++i) {
+      const long steps = static_cast<long>(positions[i]);
+      walked += std::next(map.begin(), steps)->Key();
+    }
+  });
+
+  long long check = 0;
+  for (int i = 0; i < walks; ++i) {
+    check += map.select(positions[i])->Key();
+  }
+
+  std::cout << "percentile lookups, N = " << N << "\n";
+  std::cout << "  inserts, plain " << plain_ms << " ms, with sizes "
+            << ranked_ms << " ms\n";
+  std::cout << "  select " << select_ms * 1e6 / queries
+            << " ns per lookup (key sum " << selected << ")\n";
+  std::cout << "  walk   " << walk_ms * 1e6 / walks << " ns per lookup"
+            << (walked == check ? "" : " (results differ)") << "\n";
+}
+
+// total bytes in key windows of growing width over N keys, by aggregate and
+// by summing a range
+void bench14(int N) {
+  N = N ? N : 1000000;
+  const int queries = 100;
+  std::vector<int> keys(N);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{14});
+  AugmentedMap<CS280::RedBlack, ByteTotal> map;
+  for (const int& key: keys) {
+    map.insert_or_assign(key, key % 1500);
+  }
+
+  std::cout << "window sums, N = " << N << ", " << queries
+            << " windows each\n";
+  std::mt19937 rng{140};
+  for (int width = 100; width <= N; width *= 100) {
+    std::vector<int> starts(queries);
+    for (int& start: starts) {
+      start = static_cast<int>(rng() % static_cast<unsigned>(N - width + 1));
+    }
+
+    long long aggregated = 0;
+    double aggregate_ms = time_ms([&]() {
+      for (const int& start: starts) {
+        aggregated += map.aggregate(start, start + width);
+      }
+    });
+
+    long long scanned = 0;
+    double scan_ms = time_ms([&]() {
+      for (const int& start: starts) {
+        for (auto& node: map.range(start, start + width)) {
+          scanned += node.Value();
+        }
+      }
+    });
+
+    std::cout << "  width " << width << ": aggregate "
+              << aggregate_ms * 1e3 / queries << " us, scan "
+              << scan_ms * 1e3 / queries << " us"
+              << (aggregated == scanned ? "" : " (sums differ)") << "\n";
+  }
+}
+
+// start up from N already sorted pairs, built in one go or one operator[] at
+// a time
+template<typename Map>
+void startup(const char* name, const std::vector<std::pair<int, int>>& sorted) {
+  double bulk_ms = time_ms([&]() {
+    Map map{sorted.begin(), sorted.end()};
+    if (map.size() != sorted.size()) std::cout << "Error\n";
+  });
+
+  double inserts_ms = time_ms([&]() {
+    Map map;
+    for (const std::pair<int, int>& pair: sorted) {
+      map[pair.first] = pair.second;
+    }
+    if (map.size() != sorted.size()) std::cout << "Error\n";
+  });
+
+  std::cout << "  " << name << " bulk " << bulk_ms << " ms, operator[] "
+            << inserts_ms << " ms\n";
+}
+
+void bench15(int N) {
+  N = N ? N : 5000000;
+  std::vector<std::pair<int, int>> sorted(N);
+  for (int key = 0; key < N; ++key) {
+    sorted[key] = {key, key};
+  }
+
+  using Pool = CS280::PoolAllocator<std::pair<const int, int>>;
+  std::cout << "startup from " << N << " sorted keys (teardown included)\n";
+  startup<CS280::BSTmap<int, int, CS280::AVL>>("avl      ", sorted);
+  startup<CS280::BSTmap<int, int, CS280::RedBlack>>("red-black", sorted);
+  startup<CS280::BSTmap<int, int, CS280::AVL, std::less<int>, Pool>>(
+    "avl pool ",
+    sorted
+  );
+}
+
+// batches of keys against a tree of N keys, through the batch calls and
+// through one try_emplace / find per key. The keys of a batch are either
+// scattered over the whole tree or clustered in a window about as wide as the
+// batch
+template<typename Map>
+void batch_round(const char* name, int N, int spread) {
+  const int rounds = 200;
+  const int batch_size = 5000;
+  std::vector<int> keys(N);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{16});
+
+  // built the same way, so both have the same memory layout to work with
+  Map batched;
+  Map single;
+  for (const int& key: keys) {
+    batched[key * 4] = key;
+    single[key * 4] = key;
+  }
+
+  std::mt19937 rng{160};
+  std::vector<std::vector<std::pair<int, int>>> inserts(rounds);
+  std::vector<std::vector<int>> lookups(rounds);
+  for (int round = 0; round < rounds; ++round) {
+    const unsigned base = rng() % (4u * N - spread + 1);
+    for (int i = 0; i < batch_size; ++i) {
+      inserts[round].emplace_back(base + rng() % spread, round);
+      lookups[round].push_back(static_cast<int>(base + rng() % spread));
+    }
+  }
+
+  double insert_batch_ms = time_ms([&]() {
+    for (const auto& batch: inserts) {
+      batched.insert_batch(batch);
+    }
+  });
+
+  double insert_single_ms = time_ms([&]() {
+    for (const auto& batch: inserts) {
+      for (const std::pair<int, int>& pair: batch) {
+        single.try_emplace(pair.first, pair.second);
+      }
+    }
+  });
+
+  std::vector<typename Map::iterator> found;
+  found.reserve(batch_size);
+  usize batch_hits = 0;
+  double find_batch_ms = time_ms([&]() {
+    for (const auto& batch: lookups) {
+      found.clear();
+      batched.find_batch(batch, std::back_inserter(found));
+      for (auto& it: found) {
+        batch_hits += it != batched.end() ? 1 : 0;
+      }
+    }
+  });
+
+  usize single_hits = 0;
+  double find_single_ms = time_ms([&]() {
+    for (const auto& batch: lookups) {
+      for (const int& key: batch) {
+        single_hits += single.find(key) != single.end() ? 1 : 0;
+      }
+    }
+  });
+
+  std::cout << "  " << name
+            << (batched.size() == single.size() ? "" : " (sizes differ)")
+            << "\n";
+  std::cout << "    insert_batch " << insert_batch_ms << " ms, one by one "
+            << insert_single_ms << " ms\n";
+  std::cout << "    find_batch   " << find_batch_ms << " ms, one by one "
+            << find_single_ms << " ms"
+            << (batch_hits == single_hits ? "" : " (hits differ)") << "\n";
+}
+
+void bench16(int N) {
+  N = N ? N : 1000000;
+  using Map = CS280::BSTmap<int, int, CS280::RedBlack>;
+  std::cout << "200 batches of 5000 keys, N = " << N << "\n";
+  batch_round<Map>("scattered", N, 4 * N);
+  batch_round<Map>("clustered", N, 20000);
+}
+
+// resharding a map of N keys: split at the median and join back, against
+// moving the upper half over with operator[] and erase, and merging a shard
+// of every tenth key
+void bench17(int N) {
+  N = N ? N : 10000000;
+  using Map = CS280::BSTmap<int, int, CS280::RedBlack>;
+  std::vector<std::pair<int, int>> sorted(N);
+  for (int key = 0; key < N; ++key) {
+    sorted[key] = {key, key};
+  }
+  Map map{sorted.begin(), sorted.end()};
+
+  std::pair<Map, Map> halves;
+  double split_ms = time_ms([&]() { halves = map.split(N / 2); });
+
+  double join_ms = time_ms([&]() {
+    map = Map::join(std::move(halves.first), std::move(halves.second));
+  });
+
+  Map upper;
+  double move_ms = time_ms([&]() {
+    for (auto it = map.lower_bound(N / 2); it != map.end();) {
+      upper[it->Key()] = it->Value();
+      map.erase(it++);
+    }
+  });
+
+  double back_ms = time_ms([&]() {
+    for (auto& node: upper) {
+      map[node.Key()] = node.Value();
+    }
+    upper.clear();
+  });
+
+  // every tenth key lives in a shard of its own
+  Map shard;
+  for (auto it = map.begin(); it != map.end();) {
+    if (it->Key() % 10 == 0) {
+      shard[it->Key()] = it->Value();
+      map.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  // copies on both sides, so both get the same memory layout
+  Map copy{shard};
+  Map merged{map};
+  Map target{map};
+
+  double merge_ms = time_ms([&]() { merged.merge(shard); });
+
+  double inserts_ms = time_ms([&]() {
+    for (auto it = copy.begin(); it != copy.end();) {
+      target[it->Key()] = it->Value();
+      copy.erase(it++);
+    }
+  });
+
+  std::cout << "resharding " << N << " keys"
+            << (merged.size() == target.size() and merged.sanityCheck()
+                  ? ""
+                  : " (maps differ)")
+            << "\n";
+  std::cout << "  split at the median " << split_ms << " ms, join "
+            << join_ms << " ms\n";
+  std::cout << "  the same by operator[] and erase " << move_ms
+            << " ms, and back " << back_ms << " ms\n";
+  std::cout << "  merge a shard of every tenth key " << merge_ms
+            << " ms, by operator[] and erase " << inserts_ms << " ms\n";
+}
+
+// std::allocator that keeps a tally of the bytes and blocks it hands out
+usize metered_bytes = 0;
+usize metered_blocks = 0;
+
+template<typename T>
+struct Metered {
+  using value_type = T;
+
+  Metered() = default;
+
+  template<typename U>
+  Metered(const Metered<U>&) {}
+
+  T* allocate(usize n) {
+    metered_bytes += n * sizeof(T);
+    metered_blocks++;
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T* ptr, usize n) {
+    metered_bytes -= n * sizeof(T);
+    metered_blocks--;
+    std::allocator<T>{}.deallocate(ptr, n);
+  }
+
+  template<typename U>
+  bool operator==(const Metered<U>&) const {
+    return true;
+  }
+
+  template<typename U>
+  bool operator!=(const Metered<U>&) const {
+    return false;
+  }
+};
+
+// heap taken by N random keys, in bytes per entry and blocks
+template<typename Map>
+Map footprint(const char* name, int N) {
+  std::vector<int> keys(N);
+  for (int i = 0; i < N; ++i) {
+    keys[i] = i * 2;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+
+  Map map;
+  double build_ms = time_ms([&]() {
+    for (const int& key: keys) {
+      map[key] = key;
+    }
+  });
+
+  std::cout << "  " << name << " built in " << build_ms << " ms, "
+            << static_cast<double>(metered_bytes) / N << " bytes per entry in "
+            << metered_blocks << " blocks\n";
+  return map;
+}
+
+// bytes per entry and lookup latency, nodes linked by pointer (one block
+// each, 48 bytes of links and balance) against nodes in one vector linked by
+// 32 bit index (20 bytes a node for int keys and values). malloc adds its own
+// header to every block on top of the bytes counted here
+void bench18(int N) {
+  N = N ? N : 10000000;
+  using Pair = std::pair<const int, int>;
+  using Pointers =
+    CS280::BSTmap<int, int, CS280::AVL, std::less<int>, Metered<Pair>>;
+  using Compact = CS280::CompactBSTmap<int, int, std::less<int>, Metered<Pair>>;
+
+  std::cout << "N = " << N << ", node " << sizeof(Pointers::Node) << " / "
+            << sizeof(Compact::Node) << " bytes\n";
+  footprint<Pointers>("pointers", N);
+  Compact compact = footprint<Compact>("indices ", N);
+  compact.shrink_to_fit();
+  std::cout << "  indices after shrink_to_fit "
+            << static_cast<double>(metered_bytes) / N << " bytes per entry\n";
+  lookups<Pointers>("pointers", N);
+  lookups<Compact>("indices ", N);
+}
+
+// random hits on N keys through the live red-black tree, its frozen
+// snapshot, and a binary search over the same keys in key order
+void frozen_lookups(int N) {
+  std::vector<int> keys(N);
+  for (int i = 0; i < N; ++i) {
+    keys[i] = i * 2;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+
+  CS280::BSTmap<int, int, CS280::RedBlack> map;
+  for (const int& key: keys) {
+    map[key] = key;
+  }
+
+  CS280::FrozenBSTmap<int, int> frozen;
+  double freeze_ms = time_ms([&]() { frozen = map.freeze(); });
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{281});
+
+  long long sum = 0;
+  double live_ms = time_ms([&]() {
+    for (const int& key: keys) {
+      sum += map.find(key)->Value();
+    }
+  });
+  double frozen_ms = time_ms([&]() {
+    for (const int& key: keys) {
+      sum -= frozen.find(key)->Value();
+    }
+  });
+  double sorted_ms = time_ms([&]() {
+    for (const int& key: keys) {
+      sum += std::lower_bound(
+               frozen.begin(),
+               frozen.end(),
+               key,
+               [](const auto& node, int k) { return node.Key() < k; }
+      )->Value();
+    }
+  });
+
+  std::cout << "  N = " << N << ", frozen in " << freeze_ms
+            << " ms, hits: live " << live_ms * 1e6 / N << " ns, frozen "
+            << frozen_ms * 1e6 / N << " ns, binary search "
+            << sorted_ms * 1e6 / N << " ns"
+            << (sum == static_cast<long long>(N) * (N - 1) ? "" : " (wrong)")
+            << "\n";
+}
+
+// lookups on read-mostly maps, at 1M and 10M keys unless a size is given
+// (100M live nodes take about 7 GB)
+void bench19(int N) {
+  std::cout << "live tree against its van Emde Boas snapshot\n";
+  if (N) {
+    frozen_lookups(N);
+    return;
+  }
+  frozen_lookups(1000000);
+  frozen_lookups(10000000);
+}
+
+// std::less under another name, which keeps a snapshot off the vector path
+struct ScalarLess {
+  bool operator()(int lhs, int rhs) const {
+    return lhs < rhs;
+  }
+};
+
+// ns per random hit on N keys (at least 4M hits, small maps see their keys
+// more than once): the live red-black tree, its van Emde Boas snapshot and
+// its Eytzinger snapshots with and without the vector path
+void static_lookups(int N) {
+  std::vector<int> keys(N);
+  for (int i = 0; i < N; ++i) {
+    keys[i] = i * 2;
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+
+  CS280::BSTmap<int, int, CS280::RedBlack> map;
+  CS280::BSTmap<int, int, CS280::RedBlack, ScalarLess> scalar_map;
+  for (const int& key: keys) {
+    map[key] = key;
+    scalar_map[key] = key;
+  }
+  const auto frozen = map.freeze();
+  const auto eytzinger = map.freeze_eytzinger();
+  const auto scalar = scalar_map.freeze_eytzinger();
+  scalar_map.clear();
+
+  std::vector<int> probes(std::max(N, 4000000));
+  std::mt19937 rng{281};
+  long long expected = 0;
+  for (int& probe: probes) {
+    probe = keys[rng() % N];
+    expected += probe;
+  }
+
+  long long sum = 0;
+  auto per_hit = [&](auto& lookup) {
+    return time_ms([&]() {
+             for (const int& key: probes) {
+               sum += lookup.find(key)->Value();
+             }
+           }) *
+           1e6 / static_cast<double>(probes.size());
+  };
+  double live_ns = per_hit(map);
+  double frozen_ns = per_hit(frozen);
+  double scalar_ns = per_hit(scalar);
+  double eytzinger_ns = per_hit(eytzinger);
+
+  std::cout << "  N = " << N << ": live " << live_ns << " ns, van Emde Boas "
+            << frozen_ns << " ns, Eytzinger " << scalar_ns << " ns, vector "
+            << eytzinger_ns << " ns" << (sum == 4 * expected ? "" : " (wrong)")
+            << "\n";
+}
+
+// lookups on immutable maps, at 1K, 1M and 10M keys unless a size is given
+// (the vector path only runs on maps of up to 4K int keys)
+void bench20(int N) {
+  std::cout << "random hits on frozen layouts\n";
+  if (N) {
+    static_lookups(N);
+    return;
+  }
+  static_lookups(1000);
+  static_lookups(1000000);
+  static_lookups(10000000);
+}
+
+// ns per key to insert the keys in the given order, find them all in
+// another order, walk the map once and erase them all
+template<typename Map, typename Key>
+void tree_rounds(const char* name, const std::vector<Key>& keys) {
+  std::vector<Key> probes{keys};
+  std::shuffle(probes.begin(), probes.end(), std::mt19937{281});
+
+  Map map;
+  long long sum = 0;
+  double insert_ms = time_ms([&]() {
+    for (const Key& key: keys) {
+      map[key] = 1;
+    }
+  });
+  double find_ms = time_ms([&]() {
+    for (const Key& key: probes) {
+      sum += map.find(key)->Value();
+    }
+  });
+  double walk_ms = time_ms([&]() {
+    for (auto& node: map) {
+      sum += node.Value();
+    }
+  });
+  double erase_ms = time_ms([&]() {
+    for (const Key& key: probes) {
+      sum += static_cast<long long>(map.erase(key));
+    }
+  });
+
+  const double ns = 1e6 / static_cast<double>(keys.size());
+  std::cout << "  " << name << " insert " << insert_ms * ns << ", find "
+            << find_ms * ns << ", walk " << walk_ms * ns << ", erase "
+            << erase_ms * ns << " ns"
+            << (sum == 3 * static_cast<long long>(keys.size()) ? ""
+                                                               : " (wrong)")
+            << "\n";
+}
+
+// the red-black tree against B+ trees of a few fanouts, on N random int keys
+// and the same keys as strings
+void bench21(int N) {
+  N = N ? N : 1000000;
+  std::vector<int> ints(N);
+  for (int i = 0; i < N; ++i) {
+    ints[i] = i * 2;
+  }
+  std::shuffle(ints.begin(), ints.end(), std::mt19937{280});
+
+  std::cout << "int keys, N = " << N << "\n";
+  tree_rounds<CS280::BSTmap<int, int, CS280::RedBlack>>("red-black ", ints);
+  tree_rounds<CS280::BPlusTreeMap<int, int, 16>>("B+ tree 16", ints);
+  tree_rounds<CS280::BPlusTreeMap<int, int, 32>>("B+ tree 32", ints);
+  tree_rounds<CS280::BPlusTreeMap<int, int, 64>>("B+ tree 64", ints);
+
+  std::vector<std::string> strings;
+  strings.reserve(ints.size());
+  for (const int& key: ints) {
+    strings.push_back("key:" + std::to_string(key));
+  }
+  ints.clear();
+
+  using Text = std::string;
+  std::cout << "string keys\n";
+  tree_rounds<CS280::BSTmap<Text, int, CS280::RedBlack>>("red-black ", strings);
+  tree_rounds<CS280::BPlusTreeMap<Text, int, 16>>("B+ tree 16", strings);
+  tree_rounds<CS280::BPlusTreeMap<Text, int, 32>>("B+ tree 32", strings);
+  tree_rounds<CS280::BPlusTreeMap<Text, int, 64>>("B+ tree 64", strings);
+}
+
+// ns per find of the probes in a map of the given keys, inserted in order,
+// then how many levels down the keys are found on average over the first
+// million probes run once more (const lookups, so splay trees measure the
+// depth before each find splays)
+template<typename Map>
+void probe_finds(
+  const char* name,
+  const std::vector<int>& keys,
+  const std::vector<int>& probes
+) {
+  Map map;
+  for (const int& key: keys) {
+    map[key] = 1;
+  }
+
+  long long sum = 0;
+  double ms = time_ms([&]() {
+    for (const int& key: probes) {
+      sum += map.find(key)->Value();
+    }
+  });
+
+  const usize sampled = std::min<usize>(probes.size(), 1000000);
+  const Map& view = map;
+  usize levels = 0;
+  for (usize i = 0; i < sampled; ++i) {
+    levels += view.depth(view.find(probes[i]));
+    map.find(probes[i]);
+  }
+
+  std::cout << "    " << name << " "
+            << ms * 1e6 / static_cast<double>(probes.size())
+            << " ns per find, depth "
+            << static_cast<double>(levels) / static_cast<double>(sampled)
+            << (sum == static_cast<long long>(probes.size()) ? "" : " (wrong)")
+            << "\n";
+}
+
+// finds on N keys inserted in random order, at least 4M of them drawn by a
+// Zipf law: the key of rank r comes up with weight 1 / r^s (s = 0 is
+// uniform), ranks are dealt out to the keys at random
+void zipf_finds(int N, double s) {
+  std::vector<int> keys(N);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{280});
+
+  std::vector<int> ranked{keys};
+  std::shuffle(ranked.begin(), ranked.end(), std::mt19937{281});
+
+  std::vector<double> weights(N);
+  for (int rank = 0; rank < N; ++rank) {
+    weights[rank] = 1.0 / std::pow(rank + 1.0, s);
+  }
+  std::discrete_distribution<int> zipf(weights.begin(), weights.end());
+
+  std::mt19937 rng{282};
+  std::vector<int> probes(std::max(N, 4000000));
+  for (int& probe: probes) {
+    probe = ranked[zipf(rng)];
+  }
+
+  std::cout << "  s = " << s << "\n";
+  probe_finds<CS280::BSTmap<int, int>>("unbalanced", keys, probes);
+  probe_finds<CS280::BSTmap<int, int, CS280::AVL>>("AVL       ", keys, probes);
+  probe_finds<CS280::BSTmap<int, int, CS280::RedBlack>>(
+    "red-black ",
+    keys,
+    probes
+  );
+  probe_finds<CS280::BSTmap<int, int, CS280::Splay>>(
+    "splay     ",
+    keys,
+    probes
+  );
+}
+
+// skewed lookups through every balancing policy, on 1M keys unless a size is
+// given
+void bench22(int N) {
+  N = N ? N : 1000000;
+  std::cout << "finds under a Zipf law, N = " << N << "\n";
+  for (double s: {0.0, 0.8, 1.0, 1.2, 1.5}) {
+    zipf_finds(N, s);
+  }
+}
+
+void (*pBenchmarks[])(int) = {
+  bench0,
+  bench1,
+  bench2,
+  bench3,
+  bench4,
+  bench5,
+  bench6,
+  bench7,
+  bench8,
+  bench9,
+  bench10,
+  bench11,
+  bench12,
+  bench13,
+  bench14,
+  bench15,
+  bench16,
+  bench17,
+  bench18,
+  bench19,
+  bench20,
+  bench21,
+  bench22,
+};
+
+int main(int argc, char** argv) {
+  if (argc >= 3 and std::string{argv[1]} == "bench") {
+    int bench = 0;
+    int size = 0;
+    std::sscanf(argv[2], "%i", &bench);
+    if (argc > 3) {
+      std::sscanf(argv[3], "%i", &size);
+    }
+    pBenchmarks[bench](size);
+  } else if (argc != 2) {
     return 1;
   } else {
     int test = 0;
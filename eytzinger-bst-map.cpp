@@ -0,0 +1,405 @@
+#include <cstring>
+#include <utility>
+#ifndef EYTZINGER_BSTMAP_H
+#include "eytzinger-bst-map.h"
+#endif
+
+#ifndef EYTZINGER_BSTMAP_CPP
+#define EYTZINGER_BSTMAP_CPP
+
+namespace CS280 {
+
+  template<typename K, typename V, typename Compare>
+  EytzingerBSTmap<K, V, Compare>::Node::Node(const K& key, const V& value):
+      key(key),
+      value(value) {}
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::Node::Key() const -> const K& {
+    return key;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::Node::Value() const -> const V& {
+    return value;
+  }
+
+  template<typename K, typename V, typename Compare>
+  EytzingerBSTmap<K, V, Compare>::const_iterator::const_iterator(
+    const EytzingerBSTmap* map,
+    usize index
+  ):
+      map{map},
+      index{index} {}
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator++()
+    -> const_iterator& {
+    index = map->successor(index);
+    return *this;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator++(int)
+    -> const_iterator {
+    const_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator--()
+    -> const_iterator& {
+    index = map->predecessor(index);
+    return *this;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator--(int)
+    -> const_iterator {
+    const_iterator old = *this;
+    --*this;
+    return old;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator*() const
+    -> const Node& {
+    return map->nodes[index - 1];
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator->() const
+    -> const Node* {
+    return &map->nodes[index - 1];
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator!=(
+    const const_iterator& rhs
+  ) const -> bool {
+    return index != rhs.index or map != rhs.map;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::const_iterator::operator==(
+    const const_iterator& rhs
+  ) const -> bool {
+    return index == rhs.index and map == rhs.map;
+  }
+
+  template<typename K, typename V, typename Compare>
+  template<typename T>
+  template<typename U>
+  EytzingerBSTmap<K, V, Compare>::LineAligned<T>::LineAligned(
+    const LineAligned<U>&
+  ) {}
+
+  template<typename K, typename V, typename Compare>
+  template<typename T>
+  auto EytzingerBSTmap<K, V, Compare>::LineAligned<T>::allocate(usize n)
+    -> T* {
+    return static_cast<T*>(
+      ::operator new(n * sizeof(T), std::align_val_t{line_bytes})
+    );
+  }
+
+  template<typename K, typename V, typename Compare>
+  template<typename T>
+  auto EytzingerBSTmap<K, V, Compare>::LineAligned<T>::deallocate(
+    T* ptr,
+    usize
+  ) -> void {
+    ::operator delete(ptr, std::align_val_t{line_bytes});
+  }
+
+  template<typename K, typename V, typename Compare>
+  template<typename T>
+  template<typename U>
+  auto EytzingerBSTmap<K, V, Compare>::LineAligned<T>::operator==(
+    const LineAligned<U>&
+  ) const -> bool {
+    return true;
+  }
+
+  template<typename K, typename V, typename Compare>
+  template<typename T>
+  template<typename U>
+  auto EytzingerBSTmap<K, V, Compare>::LineAligned<T>::operator!=(
+    const LineAligned<U>&
+  ) const -> bool {
+    return false;
+  }
+
+  template<typename K, typename V, typename Compare>
+  constexpr auto EytzingerBSTmap<K, V, Compare>::line_keys() -> usize {
+    usize keys = 1;
+    while (keys * 2 * sizeof(K) <= line_bytes) {
+      keys *= 2;
+    }
+    return keys;
+  }
+
+  template<typename K, typename V, typename Compare>
+  EytzingerBSTmap<K, V, Compare>::EytzingerBSTmap():
+      comp{},
+      keys{},
+      nodes{} {}
+
+  template<typename K, typename V, typename Compare>
+  EytzingerBSTmap<K, V, Compare>::EytzingerBSTmap(
+    std::vector<Node> sorted,
+    const Compare& comp
+  ):
+      comp{comp},
+      keys{},
+      nodes{std::move(sorted)} {
+    if (nodes.empty()) {
+      return;
+    }
+
+    // an in-order walk of the implicit tree hands out the sorted positions
+    std::vector<usize> rank_at(nodes.size() + 1);
+    usize rank = 0;
+    for (usize index = first(1); index; index = successor(index)) {
+      rank_at[index] = rank++;
+    }
+
+    std::vector<Node> placed;
+    placed.reserve(nodes.size());
+    keys.reserve(nodes.size() + 1);
+    keys.push_back(nodes.front().key);
+    for (usize index = 1; index <= nodes.size(); ++index) {
+      placed.push_back(std::move(nodes[rank_at[index]]));
+      keys.push_back(placed.back().key);
+    }
+    nodes = std::move(placed);
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::size() const -> usize {
+    return nodes.size();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::empty() const -> bool {
+    return nodes.empty();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::begin() const -> const_iterator {
+    return const_iterator{this, nodes.empty() ? 0 : first(1)};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::end() const -> const_iterator {
+    return const_iterator{this, 0};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::rbegin() const
+    -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::rend() const -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::find(const K& key) const
+    -> const_iterator {
+    const usize index = bound(key, false);
+
+    if (index and not comp(key, keys[index])) {
+      return const_iterator{this, index};
+    }
+
+    return end();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::lower_bound(const K& key) const
+    -> const_iterator {
+    return const_iterator{this, bound(key, false)};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::upper_bound(const K& key) const
+    -> const_iterator {
+    return const_iterator{this, bound(key, true)};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::contains(const K& key) const -> bool {
+    return find(key) != end();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::sanityCheck() const -> bool {
+    if (keys.size() != (nodes.empty() ? 0 : nodes.size() + 1)) {
+      return false;
+    }
+
+    usize visited = 0;
+    for (const_iterator it = begin(); it != end(); ++it) {
+      visited++;
+
+      const_iterator next = it;
+      ++next;
+      if (next != end() and not comp(it->key, next->key)) {
+        return false;
+      }
+
+      const K& key = keys[it.index];
+      if (comp(key, it->key) or comp(it->key, key) or
+          lower_bound(key) != it or upper_bound(key) != next) {
+        return false;
+      }
+    }
+
+    return visited == nodes.size();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::first(usize index) const -> usize {
+    while (2 * index <= nodes.size()) {
+      index = 2 * index;
+    }
+    return index;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::last(usize index) const -> usize {
+    while (2 * index + 1 <= nodes.size()) {
+      index = 2 * index + 1;
+    }
+    return index;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::successor(usize index) const -> usize {
+    if (2 * index + 1 <= nodes.size()) {
+      return first(2 * index + 1);
+    }
+
+    // up out of the right children (odd indices), then once more
+    while (index & 1) {
+      index >>= 1;
+    }
+    return index >> 1;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::predecessor(usize index) const
+    -> usize {
+    if (index == 0) {
+      return last(1);
+    }
+
+    if (2 * index <= nodes.size()) {
+      return last(2 * index);
+    }
+
+    while (index and (index & 1) == 0) {
+      index >>= 1;
+    }
+    return index >> 1;
+  }
+
+  template<typename K, typename V, typename Compare>
+  template<typename GoesRight>
+  auto EytzingerBSTmap<K, V, Compare>::descend(
+    usize index,
+    GoesRight goes_right
+  ) const -> usize {
+    const K* const base = keys.data();
+    const usize n = nodes.size();
+
+    while (index <= n) {
+#if defined(__GNUC__)
+      // the line holding the descendants a few levels down, its address is
+      // known before the comparison here settles which of them we need
+      __builtin_prefetch(base + index * line_keys());
+#endif
+      index = 2 * index + (goes_right(base[index]) ? 1 : 0);
+    }
+
+    return index;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::descend_lanes(
+    const K& key,
+    bool upper
+  ) const -> usize {
+    usize index = 1;
+
+#if defined(__GNUC__)
+    if constexpr (vectorized) {
+      typedef K Four __attribute__((vector_size(4 * sizeof(K))));
+
+      const K* const base = keys.data();
+      const usize n = nodes.size();
+      const auto past = [&key, upper](const K& at) -> usize {
+        return upper ? at <= key : at < key;
+      };
+
+      if (n * sizeof(K) > lanes_bytes) {
+        return index;
+      }
+
+      // the 15 keys under 'index' are a search tree of their own, how many
+      // of them the key is past is the gap the descent leaves them through
+      while (8 * index + 7 <= n) {
+        Four four;
+        Four low;
+        Four high;
+        std::memcpy(&four, base + 4 * index, sizeof four);
+        std::memcpy(&low, base + 8 * index, sizeof low);
+        std::memcpy(&high, base + 8 * index + 4, sizeof high);
+
+        // lanes come out as -1 where the comparison holds
+        const auto lanes = upper ? (four <= key) + (low <= key) + (high <= key)
+                                 : (four < key) + (low < key) + (high < key);
+
+        usize below = past(base[index]) + past(base[2 * index]) +
+                      past(base[2 * index + 1]);
+        below -= static_cast<usize>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+
+        index = 16 * index + below;
+      }
+    }
+#endif
+
+    static_cast<void>(key);
+    static_cast<void>(upper);
+    return index;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto EytzingerBSTmap<K, V, Compare>::bound(const K& key, bool upper) const
+    -> usize {
+    usize index = descend_lanes(key, upper);
+
+    if (upper) {
+      index = descend(index, [this, &key](const K& at) {
+        return not comp(key, at);
+      });
+    } else {
+      index = descend(index, [this, &key](const K& at) {
+        return comp(at, key);
+      });
+    }
+
+    // the right turns below the last left turn, then the left turn itself,
+    // lead back up to the bound
+    while (index & 1) {
+      index >>= 1;
+    }
+    return index >> 1;
+  }
+} // namespace CS280
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef EYTZINGER_BSTMAP_H
+#define EYTZINGER_BSTMAP_H
+
+#include "types.h"
+
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace CS280 {
+
+  /**
+   * @brief Immutable snapshot of a map for lookups, made by
+   * BSTmap::freeze_eytzinger. The keys are a complete binary search tree in
+   * breadth first (Eytzinger) order: the root at 1, the children of i at 2i
+   * and 2i + 1. A descent is a loop without branches that prefetches the
+   * cache line four levels (for 4 byte keys) below the current node, so the
+   * misses of the levels ahead overlap.
+   *
+   * Integral keys under std::less in small maps are compared 15 at a time:
+   * the four levels of the subtree below a node sit in runs of 1, 2, 4 and 8
+   * keys, and how many of them are less than the key is where the descent
+   * comes out four levels down.
+   *
+   * The key and value pairs sit in a second array in the same order, which
+   * the iterators walk, so every key is stored twice
+   *
+   * @tparam K Key
+   * @tparam V Value
+   * @tparam Compare Strict weak ordering on keys
+   */
+  template<typename K, typename V, typename Compare = std::less<K>>
+  class EytzingerBSTmap {
+
+  public:
+
+    class const_iterator;
+
+    /**
+     * @class Node
+     * @brief Key and value
+     */
+    class Node {
+    public:
+
+      /**
+       * @brief Normal constructor
+       */
+      Node(const K& k, const V& val);
+
+      /**
+       * @brief Gets the key stored
+       */
+      auto Key() const -> const K&;
+
+      /**
+       * @brief Gets the value stored
+       */
+      auto Value() const -> const V&;
+
+      friend class EytzingerBSTmap;
+
+    private:
+
+      /**
+       * @brief Key
+       */
+      K key;
+
+      /**
+       * @brief Value
+       */
+      V value;
+    };
+
+    /**
+     * @class const_iterator
+     * @brief Iterator over the snapshot in key order, steps through the tree
+     * by index arithmetic alone
+     */
+    class const_iterator {
+    public:
+
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = Node;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Node*;
+      using reference = const Node&;
+
+      /**
+       * @brief Default / normal constructor
+       */
+      const_iterator(const EytzingerBSTmap* m = nullptr, usize i = 0);
+
+      /**
+       * @brief Pre-increment
+       */
+      auto operator++() -> const_iterator&;
+
+      /**
+       * @brief Post-increment
+       */
+      auto operator++(int) -> const_iterator;
+
+      /**
+       * @brief Pre-decrement
+       */
+      auto operator--() -> const_iterator&;
+
+      /**
+       * @brief Post-decrement
+       */
+      auto operator--(int) -> const_iterator;
+
+      /**
+       * @brief Gets a reference to the inner node
+       */
+      auto operator*() const -> const Node&;
+
+      /**
+       * @brief Gets the inner node
+       */
+      auto operator->() const -> const Node*;
+
+      /**
+       * @brief Checks if this and another iter is not equal
+       */
+      auto operator!=(const const_iterator& rhs) const -> bool;
+
+      /**
+       * @brief Checks if this and another iter is equal
+       */
+      auto operator==(const const_iterator& rhs) const -> bool;
+
+      friend class EytzingerBSTmap;
+
+    private:
+
+      /**
+       * @brief Snapshot the node lives in
+       */
+      const EytzingerBSTmap* map;
+
+      /**
+       * @brief Breadth first index of the node, 0 for end()
+       */
+      usize index;
+    };
+
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    /**
+     * @brief Default constructor, an empty snapshot
+     */
+    EytzingerBSTmap();
+
+    /**
+     * @brief Lays out the given nodes, which must be sorted by key with no
+     * key twice
+     */
+    explicit EytzingerBSTmap(
+      std::vector<Node> sorted,
+      const Compare& comp = Compare()
+    );
+
+    /**
+     * @brief Gets the number of elements in the map
+     */
+    auto size() const -> usize;
+
+    /**
+     * @brief Checks if the map is empty
+     */
+    auto empty() const -> bool;
+
+    auto begin() const -> const_iterator;
+
+    auto end() const -> const_iterator;
+
+    auto rbegin() const -> const_reverse_iterator;
+
+    auto rend() const -> const_reverse_iterator;
+
+    /**
+     * @brief Gets the element with the given key, or end()
+     */
+    auto find(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is not less than the given key
+     */
+    auto lower_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is greater than the given key
+     */
+    auto upper_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Is the key in the map
+     */
+    auto contains(const K& key) const -> bool;
+
+    /**
+     * @brief Checks the ordering and that every key is found where it
+     * belongs
+     */
+    auto sanityCheck() const -> bool;
+
+  private:
+
+    /**
+     * @brief std::allocator that starts every block on a cache line, so the
+     * keys below a node share as few lines as they can
+     */
+    template<typename T>
+    struct LineAligned {
+      using value_type = T;
+
+      LineAligned() = default;
+
+      template<typename U>
+      LineAligned(const LineAligned<U>&);
+
+      [[nodiscard]] auto allocate(usize n) -> T*;
+
+      auto deallocate(T* ptr, usize n) -> void;
+
+      template<typename U>
+      auto operator==(const LineAligned<U>&) const -> bool;
+
+      template<typename U>
+      auto operator!=(const LineAligned<U>&) const -> bool;
+    };
+
+    /**
+     * @brief Bytes in a cache line
+     */
+    static constexpr usize line_bytes = 64;
+
+    /**
+     * @brief Keys in a cache line, rounded down to a power of two. The
+     * descendants this many times further down share a line
+     */
+    static constexpr auto line_keys() -> usize;
+
+    /**
+     * @brief Largest key array the vector path runs on. Further out of cache
+     * every step waits on four lines that are only known one step ahead, and
+     * the prefetching loop wins
+     */
+    static constexpr usize lanes_bytes = 16 * 1024;
+
+    /**
+     * @brief Are keys compared 15 at a time, for integral keys under
+     * std::less on compilers with vector extensions
+     */
+    static constexpr bool vectorized =
+#if defined(__GNUC__)
+      std::is_integral_v<K> and not std::is_same_v<K, bool> and
+      (std::is_same_v<Compare, std::less<K>> or
+       std::is_same_v<Compare, std::less<>>);
+#else
+      false;
+#endif
+
+    /**
+     * @brief Index of the leftmost node under 'index'
+     */
+    auto first(usize index) const -> usize;
+
+    /**
+     * @brief Index of the rightmost node under 'index'
+     */
+    auto last(usize index) const -> usize;
+
+    /**
+     * @brief Index of the next node in key order, 0 after the last
+     */
+    auto successor(usize index) const -> usize;
+
+    /**
+     * @brief Index of the previous node in key order, the last node before 0
+     */
+    auto predecessor(usize index) const -> usize;
+
+    /**
+     * @brief Goes down the tree, right wherever 'goes_right' says so for the
+     * key there, from 'index' until it falls off the bottom
+     */
+    template<typename GoesRight>
+    auto descend(usize index, GoesRight goes_right) const -> usize;
+
+    /**
+     * @brief Goes down four levels at a time while the whole subtree below
+     * is there, counting the keys less than 'key' (or not greater if
+     * 'upper'), returns where it stopped. Only for small vectorized maps
+     */
+    auto descend_lanes(const K& key, bool upper) const -> usize;
+
+    /**
+     * @brief Index of the first key not less than the given key (greater if
+     * 'upper'), 0 if there is none
+     */
+    auto bound(const K& key, bool upper) const -> usize;
+
+    /**
+     * @brief Key ordering
+     */
+    Compare comp;
+
+    /**
+     * @brief Keys in breadth first order, from index 1 (index 0 is a spare
+     * copy of the first key)
+     */
+    std::vector<K, LineAligned<K>> keys;
+
+    /**
+     * @brief Nodes in breadth first order, index i at i - 1
+     */
+    std::vector<Node> nodes;
+  };
+} // namespace CS280
+
+#ifndef EYTZINGER_BSTMAP_CPP
+#include "eytzinger-bst-map.cpp"
+#endif
+#endif
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <utility>
+#ifndef FROZEN_BSTMAP_H
+#include "frozen-bst-map.h"
+#endif
+
+#ifndef FROZEN_BSTMAP_CPP
+#define FROZEN_BSTMAP_CPP
+
+namespace CS280 {
+
+  template<typename K, typename V, typename Compare>
+  FrozenBSTmap<K, V, Compare>::Node::Node(const K& key, const V& value):
+      key(key),
+      value(value) {}
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::Node::Key() const -> const K& {
+    return key;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::Node::Value() const -> const V& {
+    return value;
+  }
+
+  template<typename K, typename V, typename Compare>
+  FrozenBSTmap<K, V, Compare>::FrozenBSTmap():
+      comp{},
+      nodes{},
+      keys{},
+      levels{},
+      height{0} {}
+
+  template<typename K, typename V, typename Compare>
+  FrozenBSTmap<K, V, Compare>::FrozenBSTmap(
+    std::vector<Node> sorted,
+    const Compare& comp
+  ):
+      comp{comp},
+      nodes{std::move(sorted)},
+      keys{},
+      levels{},
+      height{0} {
+    while ((usize{1} << height) - 1 < nodes.size()) {
+      height++;
+    }
+
+    if (height == 0) {
+      return;
+    }
+
+    levels.assign(height, Level{0, 0, 0});
+    lay_out(0, height);
+
+    // the slots past the last node still need a key for the descent to
+    // compare against, the greatest one sends every search left of them
+    keys.assign((usize{1} << height) - 1, nodes.back().key);
+
+    Path path{};
+    place(1, 0, path);
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::size() const -> usize {
+    return nodes.size();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::empty() const -> bool {
+    return nodes.empty();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::begin() const -> const_iterator {
+    return nodes.begin();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::end() const -> const_iterator {
+    return nodes.end();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::rbegin() const -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::rend() const -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::find(const K& key) const
+    -> const_iterator {
+    const const_iterator bound = lower_bound(key);
+
+    if (bound != end() and not comp(key, bound->key)) {
+      return bound;
+    }
+
+    return end();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::lower_bound(const K& key) const
+    -> const_iterator {
+    const usize rank =
+      descend([this, &key](const K& at) { return comp(at, key); });
+
+    return begin() + static_cast<std::ptrdiff_t>(rank);
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::upper_bound(const K& key) const
+    -> const_iterator {
+    const usize rank =
+      descend([this, &key](const K& at) { return not comp(key, at); });
+
+    return begin() + static_cast<std::ptrdiff_t>(rank);
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::contains(const K& key) const -> bool {
+    return find(key) != end();
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::sanityCheck() const -> bool {
+    if (keys.size() != (height ? (usize{1} << height) - 1 : 0) or
+        nodes.size() > keys.size() or
+        (height and nodes.size() <= keys.size() / 2)) {
+      return false;
+    }
+
+    for (usize rank = 0; rank < nodes.size(); ++rank) {
+      if (rank + 1 < nodes.size() and
+          not comp(nodes[rank].key, nodes[rank + 1].key)) {
+        return false;
+      }
+
+      const K& key = nodes[rank].key;
+      if (lower_bound(key) != begin() + static_cast<std::ptrdiff_t>(rank) or
+          upper_bound(key) != begin() + static_cast<std::ptrdiff_t>(rank + 1)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::lay_out(
+    usize root_depth,
+    usize subtree_height
+  ) -> void {
+    if (subtree_height < 2) {
+      return;
+    }
+
+    // the top half of the levels first, then each subtree below it in turn
+    const usize top = subtree_height / 2;
+    const usize bottom = subtree_height - top;
+
+    levels[root_depth + top] = Level{
+      root_depth,
+      (usize{1} << top) - 1,
+      (usize{1} << bottom) - 1,
+    };
+
+    lay_out(root_depth, top);
+    lay_out(root_depth + top, bottom);
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::slot(
+    usize index,
+    usize depth,
+    const Path& path
+  ) const -> usize {
+    if (depth == 0) {
+      return 0;
+    }
+
+    // past the top part of the split, then past the bottom subtrees to the
+    // left, picked out by the low bits of the index
+    const Level& level = levels[depth];
+    return path[level.top_root] + level.top_size +
+           (index & level.top_size) * level.bottom_size;
+  }
+
+  template<typename K, typename V, typename Compare>
+  auto FrozenBSTmap<K, V, Compare>::place(usize index, usize depth, Path& path)
+    -> void {
+    path[depth] = slot(index, depth, path);
+
+    // position in key order of a node in a perfect tree
+    const usize first = usize{1} << depth;
+    const usize rank = ((2 * (index - first) + 1) << (height - 1 - depth)) - 1;
+
+    if (rank < nodes.size()) {
+      keys[path[depth]] = nodes[rank].key;
+    }
+
+    if (depth + 1 < height) {
+      place(2 * index, depth + 1, path);
+      place(2 * index + 1, depth + 1, path);
+    }
+  }
+
+  template<typename K, typename V, typename Compare>
+  template<typename GoesRight>
+  auto FrozenBSTmap<K, V, Compare>::descend(GoesRight goes_right) const
+    -> usize {
+    const K* const base = keys.data();
+    Path path;
+    usize index = 1;
+
+    for (usize depth = 0; depth < height; ++depth) {
+      path[depth] = slot(index, depth, path);
+      index = 2 * index + (goes_right(base[path[depth]]) ? 1 : 0);
+    }
+
+    // the right turns below the last left turn, then the left turn itself,
+    // lead back up to the bound
+    usize depth = height;
+    while (index & 1) {
+      index >>= 1;
+      depth--;
+    }
+    index >>= 1;
+
+    if (index == 0) {
+      return nodes.size();
+    }
+    depth--;
+
+    const usize first = usize{1} << depth;
+    const usize rank = ((2 * (index - first) + 1) << (height - 1 - depth)) - 1;
+
+    return std::min(rank, nodes.size());
+  }
+} // namespace CS280
+
+#endif
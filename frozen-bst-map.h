@@ -0,0 +1,221 @@
+#ifndef FROZEN_BSTMAP_H
+#define FROZEN_BSTMAP_H
+
+#include "types.h"
+
+#include <array>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+namespace CS280 {
+
+  /**
+   * @brief Immutable snapshot of a map for lookups, made by BSTmap::freeze.
+   * The keys are laid out as a perfect binary search tree in van Emde Boas
+   * order: the top half of the levels first, then every subtree hanging off
+   * it, each laid out the same way. Any descent stays inside a block of
+   * consecutive keys for about half its levels at a time, whatever the cache
+   * line or page size, and no child links are stored at all.
+   *
+   * The tree is padded up to 2^h - 1 keys with copies of the greatest key.
+   * The key and value pairs sit in a second array in key order, which the
+   * iterators walk, so every key is stored twice
+   *
+   * @tparam K Key
+   * @tparam V Value
+   * @tparam Compare Strict weak ordering on keys
+   */
+  template<typename K, typename V, typename Compare = std::less<K>>
+  class FrozenBSTmap {
+
+  public:
+
+    /**
+     * @class Node
+     * @brief Key and value, in key order
+     */
+    class Node {
+    public:
+
+      /**
+       * @brief Normal constructor
+       */
+      Node(const K& k, const V& val);
+
+      /**
+       * @brief Gets the key stored
+       */
+      auto Key() const -> const K&;
+
+      /**
+       * @brief Gets the value stored
+       */
+      auto Value() const -> const V&;
+
+      friend class FrozenBSTmap;
+
+    private:
+
+      /**
+       * @brief Key
+       */
+      K key;
+
+      /**
+       * @brief Value
+       */
+      V value;
+    };
+
+    using const_iterator = typename std::vector<Node>::const_iterator;
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    /**
+     * @brief Default constructor, an empty snapshot
+     */
+    FrozenBSTmap();
+
+    /**
+     * @brief Lays out the given nodes, which must be sorted by key with no
+     * key twice
+     */
+    explicit FrozenBSTmap(
+      std::vector<Node> sorted,
+      const Compare& comp = Compare()
+    );
+
+    /**
+     * @brief Gets the number of elements in the map
+     */
+    auto size() const -> usize;
+
+    /**
+     * @brief Checks if the map is empty
+     */
+    auto empty() const -> bool;
+
+    auto begin() const -> const_iterator;
+
+    auto end() const -> const_iterator;
+
+    auto rbegin() const -> const_reverse_iterator;
+
+    auto rend() const -> const_reverse_iterator;
+
+    /**
+     * @brief Gets the element with the given key, or end()
+     */
+    auto find(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is not less than the given key
+     */
+    auto lower_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Gets the first element whose key is greater than the given key
+     */
+    auto upper_bound(const K& key) const -> const_iterator;
+
+    /**
+     * @brief Is the key in the map
+     */
+    auto contains(const K& key) const -> bool;
+
+    /**
+     * @brief Checks the ordering, the size of the tree and that every key is
+     * found where it belongs
+     */
+    auto sanityCheck() const -> bool;
+
+  private:
+
+    /**
+     * @brief Where the nodes at one depth sit in the layout. Each depth below
+     * the root starts the bottom subtrees of exactly one split: the subtree
+     * being split has its root 'top_root' levels down, its top part holds
+     * 'top_size' keys and every bottom subtree 'bottom_size'
+     */
+    struct Level {
+      /**
+       * @brief Depth of the root of the subtree that was split
+       */
+      usize top_root;
+
+      /**
+       * @brief Keys in the top part, also the mask that picks which bottom
+       * subtree out of a tree index
+       */
+      usize top_size;
+
+      /**
+       * @brief Keys in each bottom subtree
+       */
+      usize bottom_size;
+    };
+
+    /**
+     * @brief Slots of the nodes along a path down from the root, by depth
+     */
+    using Path = std::array<usize, 64>;
+
+    /**
+     * @brief Fills in the levels for the subtree at 'root_depth' of the given
+     * height
+     */
+    auto lay_out(usize root_depth, usize subtree_height) -> void;
+
+    /**
+     * @brief Slot of the node with the given breadth first index (the root is
+     * 1, the children of i are 2i and 2i + 1) at 'depth', 'path' holds the
+     * slots of its ancestors
+     */
+    auto slot(usize index, usize depth, const Path& path) const -> usize;
+
+    /**
+     * @brief Copies the keys of the subtree at 'index' into their slots
+     */
+    auto place(usize index, usize depth, Path& path) -> void;
+
+    /**
+     * @brief Goes down the whole tree, right wherever 'goes_right' says so
+     * for the key there, and returns the position in key order of the last
+     * key it turned left at (size() if it never did)
+     */
+    template<typename GoesRight>
+    auto descend(GoesRight goes_right) const -> usize;
+
+    /**
+     * @brief Key ordering
+     */
+    Compare comp;
+
+    /**
+     * @brief Every node, in key order
+     */
+    std::vector<Node> nodes;
+
+    /**
+     * @brief Keys of the padded tree in van Emde Boas order
+     */
+    std::vector<K> keys;
+
+    /**
+     * @brief Layout of every depth, by depth
+     */
+    std::vector<Level> levels;
+
+    /**
+     * @brief Levels of the padded tree
+     */
+    usize height;
+  };
+} // namespace CS280
+
+#ifndef FROZEN_BSTMAP_CPP
+#include "frozen-bst-map.cpp"
+#endif
+#endif
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <new>
+#ifndef POOL_ALLOCATOR_H
+#include "pool-allocator.h"
+#endif
+
+#ifndef POOL_ALLOCATOR_CPP
+#define POOL_ALLOCATOR_CPP
+
+namespace CS280 {
+
+  inline Pool::~Pool() {
+    for (void* slab: slabs) {
+      ::operator delete(slab);
+    }
+  }
+
+  inline auto Pool::fits(usize size, usize align) -> bool {
+    if (align > alignof(std::max_align_t)) {
+      return false;
+    }
+
+    if (chunk_size == 0) {
+      // every chunk starts on a max_align_t boundary and can hold a link
+      const usize unit = alignof(std::max_align_t);
+      chunk_size = (std::max(size, sizeof(FreeChunk)) + unit - 1) / unit * unit;
+    }
+
+    return size <= chunk_size;
+  }
+
+  inline auto Pool::allocate() -> void* {
+    if (free_list) {
+      FreeChunk* const chunk = free_list;
+      free_list = chunk->next;
+      free_count--;
+      return chunk;
+    }
+
+    if (bump_left == 0) {
+      grow(next_slab_chunks);
+      next_slab_chunks = std::min(next_slab_chunks * 2, max_slab_chunks);
+    }
+
+    void* const chunk = bump;
+    bump += chunk_size;
+    bump_left--;
+    return chunk;
+  }
+
+  inline auto Pool::deallocate(void* chunk) -> void {
+    free_list = ::new (chunk) FreeChunk{free_list};
+    free_count++;
+  }
+
+  inline auto Pool::reserve(usize n) -> void {
+    const usize available = free_count + bump_left;
+
+    if (n <= available) {
+      return;
+    }
+
+    // whatever is left of the current slab is put on the free list so the
+    // new slab can be bumped through in order
+    while (bump_left) {
+      deallocate(bump);
+      bump += chunk_size;
+      bump_left--;
+    }
+
+    grow(n - available);
+  }
+
+  inline auto Pool::grow(usize chunks) -> void {
+    slabs.reserve(slabs.size() + 1);
+
+    bump = static_cast<unsigned char*>(::operator new(chunks * chunk_size));
+    bump_left = chunks;
+    slabs.push_back(bump);
+  }
+
+  template<typename T>
+  PoolAllocator<T>::PoolAllocator(): pool{std::make_shared<Pool>()} {}
+
+  template<typename T>
+  template<typename U>
+  PoolAllocator<T>::PoolAllocator(const PoolAllocator<U>& other):
+      pool{other.pool} {}
+
+  template<typename T>
+  auto PoolAllocator<T>::pooled(usize n) const -> bool {
+    return n == 1 and pool->fits(sizeof(T), alignof(T));
+  }
+
+  template<typename T>
+  auto PoolAllocator<T>::allocate(usize n) -> T* {
+    if (pooled(n)) {
+      return static_cast<T*>(pool->allocate());
+    }
+
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  template<typename T>
+  auto PoolAllocator<T>::deallocate(T* ptr, usize n) -> void {
+    if (pooled(n)) {
+      pool->deallocate(ptr);
+      return;
+    }
+
+    ::operator delete(ptr);
+  }
+
+  template<typename T>
+  auto PoolAllocator<T>::reserve(usize n) -> void {
+    if (pool->fits(sizeof(T), alignof(T))) {
+      pool->reserve(n);
+    }
+  }
+
+  template<typename T>
+  template<typename U>
+  auto PoolAllocator<T>::operator==( //
+    const PoolAllocator<U>& rhs
+  ) const -> bool {
+    return pool == rhs.pool;
+  }
+
+  template<typename T>
+  template<typename U>
+  auto PoolAllocator<T>::operator!=( //
+    const PoolAllocator<U>& rhs
+  ) const -> bool {
+    return pool != rhs.pool;
+  }
+} // namespace CS280
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+
+#include "types.h"
+
+#include <memory>
+#include <vector>
+
+namespace CS280 {
+
+  /**
+   * @class Pool
+   * @brief Fixed size chunks carved out of large slabs, freed chunks go on a
+   * free list and are handed out again before the slabs grow. Slabs are only
+   * released when the pool is destroyed
+   */
+  class Pool {
+  public:
+
+    /**
+     * @brief Default constructor, the chunk size is fixed by the first
+     * allocation
+     */
+    Pool() = default;
+
+    /**
+     * @brief Copy constructor
+     */
+    Pool(const Pool&) = delete;
+
+    /**
+     * @brief Destructor, frees every slab
+     */
+    ~Pool();
+
+    /**
+     * @brief Copy assignment
+     */
+    auto operator=(const Pool&) -> Pool& = delete;
+
+    /**
+     * @brief Can an object of the given size and alignment live in a chunk
+     * (fixes the chunk size if nothing was allocated yet)
+     */
+    auto fits(usize size, usize align) -> bool;
+
+    /**
+     * @brief Takes a chunk, recycled if possible
+     */
+    auto allocate() -> void*;
+
+    /**
+     * @brief Gives a chunk back to the free list
+     */
+    auto deallocate(void* chunk) -> void;
+
+    /**
+     * @brief Makes sure the next n allocations come out of one slab (or the
+     * free list) without any further calls to the heap
+     */
+    auto reserve(usize n) -> void;
+
+  private:
+
+    /**
+     * @brief Free chunk, the link is stored inside the chunk itself
+     */
+    struct FreeChunk {
+      FreeChunk* next;
+    };
+
+    /**
+     * @brief Smallest slab, in chunks
+     */
+    static constexpr usize min_slab_chunks = 64;
+
+    /**
+     * @brief Largest slab grown on demand, in chunks (reserve can go bigger)
+     */
+    static constexpr usize max_slab_chunks = 64 * 1024;
+
+    /**
+     * @brief Allocates a new slab of the given number of chunks
+     */
+    auto grow(usize chunks) -> void;
+
+    /**
+     * @brief Size of a chunk in bytes, 0 until the first allocation
+     */
+    usize chunk_size{0};
+
+    /**
+     * @brief Recycled chunks
+     */
+    FreeChunk* free_list{nullptr};
+
+    /**
+     * @brief Next never used chunk of the newest slab
+     */
+    unsigned char* bump{nullptr};
+
+    /**
+     * @brief Never used chunks left in the newest slab
+     */
+    usize bump_left{0};
+
+    /**
+     * @brief Chunks on the free list
+     */
+    usize free_count{0};
+
+    /**
+     * @brief Chunk count of the next slab grown on demand
+     */
+    usize next_slab_chunks{min_slab_chunks};
+
+    /**
+     * @brief Every slab owned by this pool
+     */
+    std::vector<void*> slabs{};
+  };
+
+  /**
+   * @class PoolAllocator
+   * @brief std::allocator compatible front end for a Pool. Copies (and
+   * rebound copies) share the same pool, which goes away with the last copy.
+   * Single objects come from the pool, arrays and over-aligned or oversized
+   * types fall back to the global heap
+   *
+   * @tparam T Value type
+   */
+  template<typename T>
+  class PoolAllocator {
+  public:
+
+    using value_type = T;
+
+    /**
+     * @brief Default constructor, starts a new empty pool
+     */
+    PoolAllocator();
+
+    /**
+     * @brief Rebinding constructor, shares the pool of the other allocator
+     */
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>& other);
+
+    /**
+     * @brief Allocates storage for n objects
+     */
+    [[nodiscard]] auto allocate(usize n) -> T*;
+
+    /**
+     * @brief Frees storage from allocate(n)
+     */
+    auto deallocate(T* ptr, usize n) -> void;
+
+    /**
+     * @brief Makes room for n single objects in one block up front
+     */
+    auto reserve(usize n) -> void;
+
+    /**
+     * @brief Do both allocators share a pool
+     */
+    template<typename U>
+    [[nodiscard]] auto operator==(const PoolAllocator<U>& rhs) const -> bool;
+
+    /**
+     * @brief Do the allocators use different pools
+     */
+    template<typename U>
+    [[nodiscard]] auto operator!=(const PoolAllocator<U>& rhs) const -> bool;
+
+    template<typename U>
+    friend class PoolAllocator;
+
+  private:
+
+    /**
+     * @brief Is a request for n objects served by the pool
+     */
+    auto pooled(usize n) const -> bool;
+
+    /**
+     * @brief Shared pool
+     */
+    std::shared_ptr<Pool> pool;
+  };
+} // namespace CS280
+
+#ifndef POOL_ALLOCATOR_CPP
+#include "pool-allocator.cpp"
+#endif
+#endif
@@ -0,0 +1,78 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 32 Bit Floating Point Number
+ */
+using f32 = float;
+
+/**
+ * @brief 64 Bit Floating Point Number
+ */
+using f64 = long double;
+
+/**
+ * @brief Fix Sized Unsigned 8 Bit Integer (cannot be negative)
+ */
+using u8 = std::uint8_t;
+
+/**
+ * @brief Fix Sized Unsigned 16 Bit Integer (cannot be negative)
+ */
+using u16 = std::uint16_t;
+
+/**
+ * @brief Fix Sized Unsigned 32 Bit Integer (cannot be negative)
+ */
+using u32 = std::uint32_t;
+
+/**
+ * @brief Fix Sized Unsigned 64 Bit Integer (cannot be negative)
+ */
+using u64 = unsigned long int;
+
+/**
+ * @brief Biggest Unsigned Integer type that the current platform can use
+ * (cannot be negative)
+ */
+using umax = std::uintmax_t;
+
+/**
+ * @brief Unsigned Integer for when referring to any form of memory size or
+ * offset (eg. an array length or index)
+ */
+using usize = std::size_t;
+/**
+ * @brief Unsigned Integer Pointer typically used for pointer arithmetic
+ */
+using uptr = std::uintptr_t;
+
+/**
+ * @brief Signed 8 bit Integer
+ */
+using i8 = std::int8_t;
+
+/**
+ * @brief Signed 16 bit Integer
+ */
+using i16 = std::int16_t;
+
+/**
+ * @brief Signed 32 bit Integer
+ */
+using i32 = std::int32_t;
+
+/**
+ * @brief Signed 64 bit Integer
+ */
+using i64 = std::int64_t;
+
+/**
+ * @brief Integer pointer typically used for pointer arithmetic
+ */
+using iptr = std::intptr_t;
+
+#endif